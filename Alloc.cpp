@@ -0,0 +1,255 @@
+#include "Alloc.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+namespace svg
+{
+    namespace alloc
+    {
+        std::atomic<bool> active(false);
+
+        namespace
+        {
+            std::atomic<uint64_t> allocations(0), frees(0), bytes(0);
+            std::atomic<int64_t> live_bytes(0), peak_bytes(0);
+            // Counting run, incremented by start(); 0 marks uncounted blocks.
+            std::atomic<uint32_t> run(0);
+
+            // Site tables are of fixed size, since they are updated from
+            // operator new.
+            const size_t MAX_SITES = 256;
+
+            //! Add to a site of a table, or to a new one if there is room.
+            void add_site(Site *table, size_t &n, const char *name, uint64_t count, uint64_t size)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    if (table[i].name == name)
+                    {
+                        table[i].allocations += count;
+                        table[i].bytes += size;
+                        return;
+                    }
+                }
+                if (n < MAX_SITES)
+                {
+                    table[n++] = {name, count, size};
+                }
+            }
+
+            //! Sites counted by one thread, so that counting takes no lock.
+            //! Only the thread writes them; the atomics let stop() read them
+            //! while the thread runs.
+            struct ThreadSites
+            {
+                std::atomic<const char *> names[MAX_SITES];
+                std::atomic<uint64_t> allocations[MAX_SITES], bytes[MAX_SITES];
+                std::atomic<size_t> n;
+                // List of the tables of the running threads.
+                ThreadSites *prev, *next;
+
+                ThreadSites();
+                ~ThreadSites();
+                void add(const char *name, uint64_t size);
+                void merge_into(Site *table, size_t &n) const;
+            };
+
+            // Tables of the running threads, the sites of the threads that
+            // exited since start(), and the sites merged by stop().
+            std::mutex sites_mutex;
+            ThreadSites *thread_tables = nullptr;
+            Site exited_sites[MAX_SITES];
+            size_t n_exited_sites = 0;
+            Site merged_sites[MAX_SITES];
+            size_t n_merged_sites = 0;
+
+            ThreadSites::ThreadSites() : n(0), prev(nullptr)
+            {
+                std::lock_guard<std::mutex> lock(sites_mutex);
+                next = thread_tables;
+                if (next != nullptr)
+                {
+                    next->prev = this;
+                }
+                thread_tables = this;
+            }
+
+            ThreadSites::~ThreadSites()
+            {
+                std::lock_guard<std::mutex> lock(sites_mutex);
+                merge_into(exited_sites, n_exited_sites);
+                (prev != nullptr ? prev->next : thread_tables) = next;
+                if (next != nullptr)
+                {
+                    next->prev = prev;
+                }
+            }
+
+            void ThreadSites::add(const char *name, uint64_t size)
+            {
+                size_t count = n.load(std::memory_order_relaxed);
+                for (size_t i = 0; i < count; i++)
+                {
+                    if (names[i].load(std::memory_order_relaxed) == name)
+                    {
+                        allocations[i].fetch_add(1, std::memory_order_relaxed);
+                        bytes[i].fetch_add(size, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+                if (count < MAX_SITES)
+                {
+                    names[count].store(name, std::memory_order_relaxed);
+                    allocations[count].store(1, std::memory_order_relaxed);
+                    bytes[count].store(size, std::memory_order_relaxed);
+                    n.store(count + 1, std::memory_order_release);
+                }
+            }
+
+            void ThreadSites::merge_into(Site *table, size_t &count) const
+            {
+                size_t n_sites = n.load(std::memory_order_acquire);
+                for (size_t i = 0; i < n_sites; i++)
+                {
+                    add_site(table, count, names[i].load(std::memory_order_relaxed),
+                             allocations[i].load(std::memory_order_relaxed), bytes[i].load(std::memory_order_relaxed));
+                }
+            }
+
+            thread_local const char *current_site = nullptr;
+            thread_local ThreadSites thread_sites;
+        }
+
+        void start()
+        {
+            allocations = 0;
+            frees = 0;
+            bytes = 0;
+            live_bytes = 0;
+            peak_bytes = 0;
+            {
+                std::lock_guard<std::mutex> lock(sites_mutex);
+                for (ThreadSites *t = thread_tables; t != nullptr; t = t->next)
+                {
+                    t->n = 0;
+                }
+                n_exited_sites = 0;
+                n_merged_sites = 0;
+            }
+            run++;
+            active = true;
+        }
+
+        void stop()
+        {
+            active = false;
+            std::lock_guard<std::mutex> lock(sites_mutex);
+            std::copy(exited_sites, exited_sites + n_exited_sites, merged_sites);
+            n_merged_sites = n_exited_sites;
+            for (const ThreadSites *t = thread_tables; t != nullptr; t = t->next)
+            {
+                t->merge_into(merged_sites, n_merged_sites);
+            }
+        }
+
+        Counters counters()
+        {
+            Counters c;
+            c.allocations = allocations;
+            c.frees = frees;
+            c.bytes = bytes;
+            c.live_bytes = live_bytes;
+            c.peak_bytes = peak_bytes;
+            return c;
+        }
+
+        void reset_peak()
+        {
+            peak_bytes = live_bytes.load();
+        }
+
+        std::vector<Site> sites()
+        {
+            std::vector<Site> result;
+            {
+                std::lock_guard<std::mutex> lock(sites_mutex);
+                result.assign(merged_sites, merged_sites + n_merged_sites);
+            }
+            for (Site &s : result)
+            {
+                if (s.name == nullptr)
+                {
+                    s.name = "(none)";
+                }
+            }
+            std::sort(result.begin(), result.end(), [](const Site &a, const Site &b)
+                      { return a.bytes > b.bytes; });
+            return result;
+        }
+
+        uint64_t peak_rss_kb()
+        {
+            FILE *status = std::fopen("/proc/self/status", "r");
+            if (status == nullptr)
+            {
+                return 0;
+            }
+            char line[256];
+            unsigned long long kb = 0;
+            while (std::fgets(line, sizeof(line), status) != nullptr)
+            {
+                if (std::sscanf(line, "VmHWM: %llu kB", &kb) == 1)
+                {
+                    break;
+                }
+            }
+            std::fclose(status);
+            return kb;
+        }
+
+        void reset_peak_rss()
+        {
+            // Writing 5 to clear_refs resets VmHWM (Linux 4.0 and later).
+            FILE *clear_refs = std::fopen("/proc/self/clear_refs", "w");
+            if (clear_refs != nullptr)
+            {
+                std::fputs("5", clear_refs);
+                std::fclose(clear_refs);
+            }
+        }
+
+        const char *exchange_site(const char *name)
+        {
+            const char *previous = current_site;
+            current_site = name;
+            return previous;
+        }
+
+        uint32_t on_alloc(size_t requested, size_t usable)
+        {
+            allocations.fetch_add(1, std::memory_order_relaxed);
+            bytes.fetch_add(requested, std::memory_order_relaxed);
+            int64_t live = live_bytes.fetch_add((int64_t)usable, std::memory_order_relaxed) + (int64_t)usable;
+            int64_t peak = peak_bytes.load(std::memory_order_relaxed);
+            while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+            {
+            }
+            thread_sites.add(current_site, requested);
+            return run.load(std::memory_order_relaxed);
+        }
+
+        void on_free(size_t usable, uint32_t block_run)
+        {
+            if (block_run != run.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            frees.fetch_add(1, std::memory_order_relaxed);
+            live_bytes.fetch_sub((int64_t)usable, std::memory_order_relaxed);
+        }
+    }
+}
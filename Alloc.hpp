@@ -0,0 +1,86 @@
+//! @file Alloc.hpp
+#ifndef __svg_Alloc_hpp__
+#define __svg_Alloc_hpp__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace svg
+{
+    //! Heap allocation counters, fed by the global operator new/delete
+    //! replacements of AllocHooks.cpp (linked into svgbench only) and by
+    //! PNGImage for its pixels. Counting is enabled by start(); allocations
+    //! are attributed to the innermost trace scope (see Trace.hpp) of the
+    //! allocating thread, their site. Only the frees of blocks counted since
+    //! the last start() are counted, so the live heap of a run starts at 0.
+    namespace alloc
+    {
+        //! True while counting (use enabled() to read it).
+        extern std::atomic<bool> active;
+
+        //! Check whether allocations are being counted.
+        //! @return True if counting.
+        inline bool enabled() { return active.load(std::memory_order_relaxed); }
+
+        //! Counter values since start().
+        struct Counters
+        {
+            //! Number of allocations and frees.
+            uint64_t allocations = 0, frees = 0;
+            //! Bytes requested by the allocations.
+            uint64_t bytes = 0;
+            //! Live heap (allocated minus freed, in usable bytes), and its
+            //! maximum since start() or the last reset_peak().
+            int64_t live_bytes = 0, peak_bytes = 0;
+        };
+
+        //! Allocations of one site.
+        struct Site
+        {
+            //! Site name (trace scope name), or "(none)".
+            const char *name;
+            uint64_t allocations;
+            uint64_t bytes;
+        };
+
+        //! Reset the counters and the sites and start counting.
+        void start();
+        //! Stop counting, and merge the sites counted by each thread.
+        void stop();
+        //! Get the counters.
+        //! @return The current values.
+        Counters counters();
+        //! Restart the peak from the current live heap, e.g. at a phase start.
+        void reset_peak();
+        //! Get the allocation sites, by decreasing bytes, as merged by stop().
+        //! @return The sites.
+        std::vector<Site> sites();
+
+        //! Peak resident set size of the process, in KiB (VmHWM).
+        //! @return The peak, or 0 if unknown.
+        uint64_t peak_rss_kb();
+        //! Restart the peak resident set size from the current one, when the
+        //! kernel allows it.
+        void reset_peak_rss();
+
+        //! Set the allocation site of the calling thread.
+        //! @param name Site name (must be a string literal), or nullptr.
+        //! @return The previous site.
+        const char *exchange_site(const char *name);
+
+        //! Record an allocation (called by the operator new replacements,
+        //! while counting).
+        //! @param requested Requested size.
+        //! @param usable Usable size of the block.
+        //! @return Number of the counting run, to keep with the block for on_free.
+        uint32_t on_alloc(size_t requested, size_t usable);
+        //! Record a free (called by the operator delete replacements). Blocks
+        //! counted in an earlier run, or not at all (run 0), are ignored.
+        //! @param usable Usable size of the block.
+        //! @param run Value returned by on_alloc for the block.
+        void on_free(size_t usable, uint32_t run);
+    }
+}
+#endif
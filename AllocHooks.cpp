@@ -0,0 +1,94 @@
+// Replacements of the global allocation functions feeding the alloc
+// counters (see Alloc.hpp). Only linked into programs that profile
+// allocations; when counting is off they cost a flag test.
+#include "Alloc.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+namespace
+{
+    //! Header in front of every block, keeping the counting run the block
+    //! was counted in (0 if none), so that only the frees of counted blocks
+    //! are counted.
+    struct alignas(alignof(std::max_align_t)) Header
+    {
+        size_t usable;
+        uint32_t run;
+    };
+
+    void *allocate(size_t size)
+    {
+        Header *h = (Header *)std::malloc(sizeof(Header) + size);
+        if (h == nullptr)
+        {
+            return nullptr;
+        }
+        h->usable = ::malloc_usable_size(h) - sizeof(Header);
+        h->run = svg::alloc::enabled() ? svg::alloc::on_alloc(size, h->usable) : 0;
+        return h + 1;
+    }
+
+    void deallocate(void *p)
+    {
+        if (p == nullptr)
+        {
+            return;
+        }
+        Header *h = (Header *)p - 1;
+        if (h->run != 0 && svg::alloc::enabled())
+        {
+            svg::alloc::on_free(h->usable, h->run);
+        }
+        std::free(h);
+    }
+}
+
+void *operator new(size_t size)
+{
+    void *p = allocate(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    deallocate(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    deallocate(p);
+}
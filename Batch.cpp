@@ -0,0 +1,218 @@
+#include "SVGElements.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace svg
+{
+    namespace
+    {
+        //! Blocking FIFO queue of limited capacity between two pipeline stages.
+        //! The producing stage closes it once all its threads are done.
+        template <typename T>
+        class BoundedQueue
+        {
+        public:
+            BoundedQueue(size_t capacity, int producers)
+                : capacity(std::max<size_t>(1, capacity)), producers(producers) {}
+
+            //! Add an item, waiting while the queue is full.
+            void push(T item)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_full.wait(lock, [this]()
+                              { return items.size() < capacity; });
+                items.push_back(std::move(item));
+                not_empty.notify_one();
+            }
+            //! Take the oldest item, waiting while the queue is empty.
+            //! @return False once the queue is empty and closed.
+            bool pop(T &item)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                not_empty.wait(lock, [this]()
+                               { return !items.empty() || producers == 0; });
+                if (items.empty())
+                {
+                    return false;
+                }
+                item = std::move(items.front());
+                items.pop_front();
+                not_full.notify_one();
+                return true;
+            }
+            //! Called by each producer thread when done; the last one closes the queue.
+            void producer_done()
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--producers == 0)
+                {
+                    not_empty.notify_all();
+                }
+            }
+
+        private:
+            size_t capacity;
+            int producers;
+            std::deque<T> items;
+            std::mutex mutex;
+            std::condition_variable not_empty, not_full;
+        };
+
+        //! A file between the load and raster stages.
+        struct LoadedFile
+        {
+            size_t index;
+            std::unique_ptr<Scene> scene;
+        };
+
+        //! A file between the raster and encode stages.
+        struct RenderedFile
+        {
+            size_t index;
+            std::unique_ptr<PNGImage> image;
+        };
+
+        int thread_count(int jobs)
+        {
+            return std::max(1, jobs > 0 ? jobs : (int)std::thread::hardware_concurrency());
+        }
+
+        //! Run fn on n threads (the calling one included) and wait for them.
+        template <typename F>
+        void run_threads(int n, F fn)
+        {
+            std::vector<std::thread> threads;
+            for (int t = 1; t < n; t++)
+            {
+                threads.emplace_back(fn);
+            }
+            fn();
+            for (std::thread &t : threads)
+            {
+                t.join();
+            }
+        }
+
+        std::string error_message(std::exception_ptr error)
+        {
+            try
+            {
+                std::rethrow_exception(error);
+            }
+            catch (const std::exception &e)
+            {
+                return e.what();
+            }
+            catch (...)
+            {
+                return "unknown error";
+            }
+        }
+    }
+
+    int convert_batch(const std::vector<std::string> &svg_files, const std::vector<std::string> &png_files,
+                      const BatchOptions &options, std::vector<std::string> &errors)
+    {
+        trace::Session session;
+        errors.assign(svg_files.size(), std::string());
+        int converted = 0;
+        {
+            TRACE_SCOPE("convert_batch", "batch");
+            int load_threads = thread_count(options.load_jobs);
+            int raster_threads = thread_count(options.raster_jobs);
+            int encode_threads = thread_count(options.encode_jobs);
+            BoundedQueue<LoadedFile> loaded(options.queue_depth, load_threads);
+            BoundedQueue<RenderedFile> rendered(options.queue_depth, raster_threads);
+            std::atomic<size_t> next_file(0);
+            std::atomic<int> done(0);
+            // Each file is handled by one thread per stage, so its error slot
+            // is only written once.
+            auto fail = [&](size_t index, std::exception_ptr error)
+            {
+                errors[index] = svg_files[index] + ": " + error_message(error);
+            };
+
+            auto load = [&]()
+            {
+                for (size_t i = next_file++; i < svg_files.size(); i = next_file++)
+                {
+                    try
+                    {
+                        TRACE_SCOPE("load", "batch");
+                        std::unique_ptr<Scene> scene(new Scene());
+                        load_scene(svg_files[i], options.render, *scene);
+                        loaded.push({i, std::move(scene)});
+                    }
+                    catch (...)
+                    {
+                        fail(i, std::current_exception());
+                    }
+                }
+                loaded.producer_done();
+            };
+            auto raster = [&]()
+            {
+                LoadedFile file;
+                while (loaded.pop(file))
+                {
+                    try
+                    {
+                        TRACE_SCOPE("raster", "batch");
+                        std::unique_ptr<PNGImage> img(new PNGImage(file.scene->width, file.scene->height, options.render.storage));
+                        img->set_antialiasing(options.render.antialiasing);
+                        for (SVGElement *e : file.scene->elements)
+                        {
+                            e->draw(*img);
+                        }
+                        // Free the geometry before waiting for the encoders.
+                        file.scene.reset();
+                        rendered.push({file.index, std::move(img)});
+                    }
+                    catch (...)
+                    {
+                        fail(file.index, std::current_exception());
+                    }
+                }
+                rendered.producer_done();
+            };
+            auto encode = [&]()
+            {
+                RenderedFile file;
+                while (rendered.pop(file))
+                {
+                    try
+                    {
+                        TRACE_SCOPE("encode", "batch");
+                        file.image->save(png_files[file.index]);
+                        file.image.reset();
+                        done++;
+                    }
+                    catch (...)
+                    {
+                        fail(file.index, std::current_exception());
+                    }
+                }
+            };
+
+            std::thread loaders([&]()
+                                { run_threads(load_threads, load); });
+            std::thread rasterizers([&]()
+                                    { run_threads(raster_threads, raster); });
+            run_threads(encode_threads, encode);
+            loaders.join();
+            rasterizers.join();
+            converted = done;
+        }
+        return converted;
+    }
+}
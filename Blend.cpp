@@ -0,0 +1,153 @@
+#include "Blend.hpp"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace svg
+{
+#ifdef __SSE2__
+    namespace
+    {
+        //! Divide 16-bit lanes holding x + 128 by 255 (rounded), as blend_component does.
+        inline __m128i div255(__m128i t)
+        {
+            return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        }
+
+        //! Blend 16 bytes given the source bytes already multiplied by alpha plus 128.
+        inline __m128i blend16_premul(__m128i src_lo, __m128i src_hi, __m128i dst, __m128i inv)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), inv), src_lo);
+            __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), inv), src_hi);
+            return _mm_packus_epi16(div255(lo), div255(hi));
+        }
+    }
+#endif
+
+    void blend_span(Color *dst, size_t n, const Color &c, int alpha)
+    {
+        if (alpha >= 255)
+        {
+            std::fill(dst, dst + n, c);
+            return;
+        }
+        if (alpha <= 0)
+        {
+            return;
+        }
+        unsigned char *d = (unsigned char *)dst;
+        size_t bytes = n * sizeof(Color);
+        size_t i = 0;
+#ifdef __SSE2__
+        if (bytes >= 48)
+        {
+            // 48 bytes = 16 pixels: three vectors whose color pattern repeats.
+            unsigned char pattern[48];
+            for (int k = 0; k < 16; k++)
+            {
+                pattern[3 * k] = c.red;
+                pattern[3 * k + 1] = c.green;
+                pattern[3 * k + 2] = c.blue;
+            }
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i va = _mm_set1_epi16((short)alpha);
+            const __m128i inv = _mm_set1_epi16((short)(255 - alpha));
+            const __m128i bias = _mm_set1_epi16(128);
+            __m128i src_lo[3], src_hi[3];
+            for (int j = 0; j < 3; j++)
+            {
+                __m128i s = _mm_loadu_si128((const __m128i *)(pattern + 16 * j));
+                src_lo[j] = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), va), bias);
+                src_hi[j] = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), va), bias);
+            }
+            for (; i + 48 <= bytes; i += 48)
+            {
+                for (int j = 0; j < 3; j++)
+                {
+                    __m128i *p = (__m128i *)(d + i + 16 * j);
+                    _mm_storeu_si128(p, blend16_premul(src_lo[j], src_hi[j], _mm_loadu_si128(p), inv));
+                }
+            }
+        }
+#endif
+        // Remaining pixels (i is a multiple of 3 here).
+        for (; i < bytes; i += 3)
+        {
+            blend_pixel(*(Color *)(d + i), c, alpha);
+        }
+    }
+
+    void blend_pixels(Color *out, const Color *src, const Color *bg, size_t n, int alpha)
+    {
+        unsigned char *o = (unsigned char *)out;
+        const unsigned char *s = (const unsigned char *)src;
+        const unsigned char *b = (const unsigned char *)bg;
+        size_t bytes = n * sizeof(Color);
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i va = _mm_set1_epi16((short)alpha);
+        const __m128i inv = _mm_set1_epi16((short)(255 - alpha));
+        const __m128i bias = _mm_set1_epi16(128);
+        for (; i + 16 <= bytes; i += 16)
+        {
+            __m128i sv = _mm_loadu_si128((const __m128i *)(s + i));
+            __m128i src_lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(sv, zero), va), bias);
+            __m128i src_hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(sv, zero), va), bias);
+            __m128i bv = _mm_loadu_si128((const __m128i *)(b + i));
+            _mm_storeu_si128((__m128i *)(o + i), blend16_premul(src_lo, src_hi, bv, inv));
+        }
+#endif
+        for (; i < bytes; i++)
+        {
+            o[i] = blend_component(s[i], b[i], alpha);
+        }
+    }
+
+    void blend_shaded_span(Color *dst, const Color *src, const unsigned char *alphas, size_t n, int alpha)
+    {
+        unsigned char *d = (unsigned char *)dst;
+        const unsigned char *s = (const unsigned char *)src;
+        size_t bytes = n * sizeof(Color);
+        size_t i = 0;
+#ifdef __SSE2__
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i va = _mm_set1_epi16((short)alpha);
+        const __m128i bias = _mm_set1_epi16(128);
+        const __m128i full = _mm_set1_epi16(255);
+        for (; i + 16 <= bytes; i += 16)
+        {
+            __m128i av = _mm_loadu_si128((const __m128i *)(alphas + i));
+            __m128i a_lo = _mm_unpacklo_epi8(av, zero), a_hi = _mm_unpackhi_epi8(av, zero);
+            if (alpha < 255)
+            {
+                a_lo = div255(_mm_add_epi16(_mm_mullo_epi16(a_lo, va), bias));
+                a_hi = div255(_mm_add_epi16(_mm_mullo_epi16(a_hi, va), bias));
+            }
+            __m128i sv = _mm_loadu_si128((const __m128i *)(s + i));
+            __m128i dv = _mm_loadu_si128((const __m128i *)(d + i));
+            __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(sv, zero), a_lo),
+                                                     _mm_mullo_epi16(_mm_unpacklo_epi8(dv, zero), _mm_sub_epi16(full, a_lo))),
+                                       bias);
+            __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(sv, zero), a_hi),
+                                                     _mm_mullo_epi16(_mm_unpackhi_epi8(dv, zero), _mm_sub_epi16(full, a_hi))),
+                                       bias);
+            _mm_storeu_si128((__m128i *)(d + i), _mm_packus_epi16(div255(lo), div255(hi)));
+        }
+#endif
+        for (; i < bytes; i++)
+        {
+            int a = alphas[i];
+            if (alpha < 255)
+            {
+                int t = a * alpha + 128;
+                a = (t + (t >> 8)) >> 8;
+            }
+            d[i] = blend_component(s[i], d[i], a);
+        }
+    }
+}
@@ -0,0 +1,63 @@
+//! @file Blend.hpp
+#ifndef __svg_Blend_hpp__
+#define __svg_Blend_hpp__
+
+#include "Color.hpp"
+
+#include <cstddef>
+
+namespace svg
+{
+    //! Source-over blend of one color component: (src * alpha + dst * (255 - alpha)) / 255,
+    //! rounded to nearest. All span kernels produce exactly this value.
+    //! @param src Source component.
+    //! @param dst Destination component.
+    //! @param alpha Source alpha in [0, 255].
+    //! @return Blended component.
+    inline rgb_value blend_component(int src, int dst, int alpha)
+    {
+        int t = src * alpha + dst * (255 - alpha) + 128;
+        return (rgb_value)((t + (t >> 8)) >> 8);
+    }
+
+    //! Blend a single color over a pixel.
+    //! @param p Pixel.
+    //! @param c Source color.
+    //! @param alpha Source alpha in [0, 255].
+    inline void blend_pixel(Color &p, const Color &c, int alpha)
+    {
+        p.red = blend_component(c.red, p.red, alpha);
+        p.green = blend_component(c.green, p.green, alpha);
+        p.blue = blend_component(c.blue, p.blue, alpha);
+    }
+
+    //! Blend a single color over a horizontal run of pixels.
+    //! Uses SSE2 when available (16 pixels per iteration).
+    //! @param dst First pixel of the run.
+    //! @param n Number of pixels.
+    //! @param c Source color.
+    //! @param alpha Source alpha in [0, 255].
+    void blend_span(Color *dst, size_t n, const Color &c, int alpha);
+
+    //! Blend a run of source pixels over a run of background pixels:
+    //! out[i] = src[i] * alpha + bg[i] * (255 - alpha). out may alias src or bg.
+    //! Uses SSE2 when available.
+    //! @param out Output pixels.
+    //! @param src Source pixels.
+    //! @param bg Background pixels.
+    //! @param n Number of pixels.
+    //! @param alpha Source alpha in [0, 255].
+    void blend_pixels(Color *out, const Color *src, const Color *bg, size_t n, int alpha);
+
+    //! Blend a run of source pixels, each with its own alpha, over a run of pixels:
+    //! dst[i] = src[i] * a[i] + dst[i] * (255 - a[i]), where a[i] is alphas[i]
+    //! scaled by alpha (both in [0, 255], combined as blend_component rounds).
+    //! Uses SSE2 when available.
+    //! @param dst Pixels.
+    //! @param src Source pixels.
+    //! @param alphas Source alphas, repeated for each component (3 per pixel).
+    //! @param n Number of pixels.
+    //! @param alpha Alpha applied to all the source pixels.
+    void blend_shaded_span(Color *dst, const Color *src, const unsigned char *alphas, size_t n, int alpha);
+}
+#endif
@@ -0,0 +1,87 @@
+#include "Geometry.hpp"
+
+#include <algorithm>
+
+namespace svg
+{
+    PointList::PointList()
+        : PointList(std::vector<FixedPoint>())
+    {
+    }
+
+    PointList::PointList(const std::vector<FixedPoint> &points)
+        : points_(std::make_shared<const std::vector<FixedPoint>>(points)), offset_({0, 0})
+    {
+    }
+
+    PointList::PointList(const std::shared_ptr<const std::vector<FixedPoint>> &points, const FixedPoint &offset)
+        : points_(points), offset_(offset)
+    {
+    }
+
+    std::vector<FixedPoint> PointList::to_vector() const
+    {
+        std::vector<FixedPoint> points;
+        copy_to(points);
+        return points;
+    }
+
+    void PointList::copy_to(std::vector<FixedPoint> &points) const
+    {
+        points.clear();
+        points.reserve(size());
+        for (const FixedPoint &p : *points_)
+        {
+            points.push_back(p.translate(offset_));
+        }
+    }
+
+    void PointList::translate(const FixedPoint &t)
+    {
+        offset_ = offset_.translate(t);
+    }
+
+    PointList GeometryPool::intern(const PointList &points)
+    {
+        stats_.lists++;
+        stats_.points += points.size();
+        if (points.size() == 0)
+        {
+            return points;
+        }
+        // Points relative to the first one, so translated copies compare equal.
+        FixedPoint origin = points[0];
+        std::vector<FixedPoint> relative;
+        relative.reserve(points.size());
+        size_t hash = points.size();
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            FixedPoint p = points[i];
+            relative.push_back({p.x - origin.x, p.y - origin.y});
+            hash = hash * 1000003u ^ (size_t)(unsigned)relative.back().x;
+            hash = hash * 1000003u ^ (size_t)(unsigned)relative.back().y;
+        }
+        auto range = storage_.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            const std::vector<FixedPoint> &shared = *it->second;
+            if (shared.size() == relative.size() &&
+                std::equal(relative.begin(), relative.end(), shared.begin(),
+                           [](const FixedPoint &a, const FixedPoint &b)
+                           { return a.x == b.x && a.y == b.y; }))
+            {
+                stats_.bytes_saved += relative.size() * sizeof(FixedPoint);
+                return PointList(it->second, origin);
+            }
+        }
+        stats_.unique_lists++;
+        auto shared = std::make_shared<const std::vector<FixedPoint>>(std::move(relative));
+        storage_.emplace(hash, shared);
+        return PointList(shared, origin);
+    }
+
+    const GeometryStats &GeometryPool::stats() const
+    {
+        return stats_;
+    }
+}
@@ -0,0 +1,93 @@
+//! @file Geometry.hpp
+#ifndef __svg_Geometry_hpp__
+#define __svg_Geometry_hpp__
+
+#include "Point.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace svg
+{
+    //! Point sequence of a polygon or polyline. Points are stored relative to
+    //! an offset, and the storage is shared between copies (clones, <use>
+    //! instances, or equal lists merged by GeometryPool), so a translation only
+    //! moves the offset. Any other change gives the list its own storage.
+    class PointList
+    {
+    public:
+        //! Empty list.
+        PointList();
+        //! List with its own storage.
+        //! @param points Points.
+        PointList(const std::vector<FixedPoint> &points);
+
+        //! Number of points.
+        //! @return The size.
+        size_t size() const { return points_->size(); }
+        //! Get a point.
+        //! @param i Index, less than size().
+        //! @return The point.
+        FixedPoint operator[](size_t i) const
+        {
+            const FixedPoint &p = (*points_)[i];
+            return {p.x + offset_.x, p.y + offset_.y};
+        }
+        //! Copy the points.
+        //! @return The points.
+        std::vector<FixedPoint> to_vector() const;
+        //! Copy the points into a vector, replacing its contents but keeping
+        //! its memory.
+        //! @param points Output points.
+        void copy_to(std::vector<FixedPoint> &points) const;
+        //! Translate all points, keeping the storage shared.
+        //! @param t Translation.
+        void translate(const FixedPoint &t);
+        //! Check if two lists share their storage.
+        //! @param other Other list.
+        //! @return True if shared.
+        bool shares_storage(const PointList &other) const { return points_ == other.points_; }
+
+    private:
+        friend class GeometryPool;
+        PointList(const std::shared_ptr<const std::vector<FixedPoint>> &points, const FixedPoint &offset);
+
+        std::shared_ptr<const std::vector<FixedPoint>> points_;
+        FixedPoint offset_;
+    };
+
+    //! Geometry sharing statistics (see GeometryPool).
+    struct GeometryStats
+    {
+        //! Point lists seen.
+        size_t lists = 0;
+        //! Distinct point lists, up to a translation.
+        size_t unique_lists = 0;
+        //! Points in all lists.
+        size_t points = 0;
+        //! Point storage no longer needed by the lists sharing another's storage.
+        size_t bytes_saved = 0;
+    };
+
+    //! Hash-consing of point lists: lists equal up to a translation share one
+    //! storage, kept with its first point at the origin.
+    class GeometryPool
+    {
+    public:
+        //! Get the shared version of a list.
+        //! @param points Point list.
+        //! @return An equal list, sharing storage with the equal lists interned before.
+        PointList intern(const PointList &points);
+        //! Statistics of the lists interned so far.
+        //! @return The statistics.
+        const GeometryStats &stats() const;
+
+    private:
+        //! Shared storages, by hash of the points relative to the first one.
+        std::unordered_multimap<size_t, std::shared_ptr<const std::vector<FixedPoint>>> storage_;
+        GeometryStats stats_;
+    };
+}
+#endif
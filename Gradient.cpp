@@ -0,0 +1,172 @@
+#include "Gradient.hpp"
+#include "Blend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace svg
+{
+    namespace
+    {
+        //! Pixels shaded at a time (a multiple of 4).
+        const size_t CHUNK = 64;
+
+        //! Sample the stops, padding before the first one and after the last one.
+        std::shared_ptr<const GradientRamp> build_ramp(const std::vector<GradientStop> &stops)
+        {
+            std::shared_ptr<GradientRamp> ramp = std::make_shared<GradientRamp>();
+            ramp->opaque = true;
+            for (int i = 0; i < GradientRamp::SIZE; i++)
+            {
+                double t = i / (double)(GradientRamp::SIZE - 1);
+                // First stop after t; with equal offsets, the later stop wins.
+                size_t k = 0;
+                while (k < stops.size() && stops[k].offset <= t)
+                {
+                    k++;
+                }
+                Color color = {0, 0, 0};
+                double opacity = 0;  // No stops: nothing is painted.
+                if (!stops.empty())
+                {
+                    const GradientStop &a = stops[k == 0 ? 0 : k - 1];
+                    const GradientStop &b = stops[k == stops.size() ? k - 1 : k];
+                    double f = b.offset > a.offset ? std::min(1.0, std::max(0.0, (t - a.offset) / (b.offset - a.offset))) : 0;
+                    color = {(rgb_value)::lround(a.color.red + f * (b.color.red - a.color.red)),
+                             (rgb_value)::lround(a.color.green + f * (b.color.green - a.color.green)),
+                             (rgb_value)::lround(a.color.blue + f * (b.color.blue - a.color.blue))};
+                    opacity = a.opacity + f * (b.opacity - a.opacity);
+                }
+                unsigned char alpha = (unsigned char)::lround(std::min(1.0, std::max(0.0, opacity)) * 255);
+                ramp->colors[i] = color;
+                std::memset(ramp->alphas + 3 * i, alpha, 3);
+                ramp->opaque = ramp->opaque && alpha == 255;
+            }
+            return ramp;
+        }
+    }
+
+    Gradient::Gradient(Type type, const Affine &to_gradient, const std::vector<GradientStop> &stops)
+        : type(type), to_gradient(to_gradient), ramp(build_ramp(stops)) {}
+
+    Gradient Gradient::linear(const Vertex &p0, const Vertex &p1, const std::vector<GradientStop> &stops)
+    {
+        double dx = p1.x - p0.x, dy = p1.y - p0.y;
+        double len2 = dx * dx + dy * dy;
+        if (len2 == 0)
+        {
+            return Gradient(Type::Linear, {0, 0, 1, 0, 0, 0}, stops);
+        }
+        // u = (p - p0) . (p1 - p0) / |p1 - p0|^2.
+        return Gradient(Type::Linear, {dx / len2, dy / len2, -(p0.x * dx + p0.y * dy) / len2, 0, 0, 0}, stops);
+    }
+
+    Gradient Gradient::radial(const Vertex &center, double r, const std::vector<GradientStop> &stops)
+    {
+        if (r <= 0)
+        {
+            return Gradient(Type::Linear, {0, 0, 1, 0, 0, 0}, stops);
+        }
+        return Gradient(Type::Radial, {1 / r, 0, -center.x / r, 0, 1 / r, -center.y / r}, stops);
+    }
+
+    Gradient Gradient::transformed(const Affine &m) const
+    {
+        Gradient g = *this;
+        // A degenerate map flattens the shape too, leaving nothing to fill.
+        if (m.a * m.e - m.b * m.d != 0)
+        {
+            g.to_gradient = to_gradient * m.inverse();
+        }
+        return g;
+    }
+
+    bool Gradient::opaque() const
+    {
+        return ramp->opaque;
+    }
+
+    void Gradient::lookup(int x, int y, size_t n, int *indices) const
+    {
+        const Affine &m = to_gradient;
+        // (u, v) at pixel x + i is (u0 + i du, v0 + i dv); i is exact in float.
+        float u0 = (float)(m.a * x + m.b * y + m.c), du = (float)m.a;
+        float v0 = (float)(m.d * x + m.e * y + m.f), dv = (float)m.d;
+        const float last = GradientRamp::SIZE - 1;
+        bool radial = type == Type::Radial;
+#ifdef __SSE2__
+        const __m128 lanes = _mm_set_ps(3, 2, 1, 0);
+        const __m128 vu0 = _mm_set1_ps(u0), vdu = _mm_set1_ps(du);
+        const __m128 vv0 = _mm_set1_ps(v0), vdv = _mm_set1_ps(dv);
+        const __m128 vlast = _mm_set1_ps(last), zero = _mm_setzero_ps();
+        for (size_t i = 0; i < n; i += 4)
+        {
+            __m128 k = _mm_add_ps(_mm_set1_ps((float)i), lanes);
+            __m128 t = _mm_add_ps(vu0, _mm_mul_ps(k, vdu));
+            if (radial)
+            {
+                __m128 v = _mm_add_ps(vv0, _mm_mul_ps(k, vdv));
+                t = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(t, t), _mm_mul_ps(v, v)));
+            }
+            // Pad, then round to the nearest sample.
+            t = _mm_min_ps(_mm_max_ps(_mm_mul_ps(t, vlast), zero), vlast);
+            _mm_storeu_si128((__m128i *)(indices + i), _mm_cvtps_epi32(t));
+        }
+#else
+        for (size_t i = 0; i < n; i++)
+        {
+            float t = u0 + (float)i * du;
+            if (radial)
+            {
+                float v = v0 + (float)i * dv;
+                t = std::sqrt(t * t + v * v);
+            }
+            indices[i] = (int)std::lrint(std::min(std::max(t * last, 0.0f), last));
+        }
+#endif
+    }
+
+    void Gradient::shade_span(Color *dst, int x, int y, size_t n, int alpha) const
+    {
+        if (alpha <= 0)
+        {
+            return;
+        }
+        const GradientRamp &r = *ramp;
+        int indices[CHUNK];
+        Color colors[CHUNK];
+        unsigned char alphas[3 * CHUNK];
+        for (size_t done = 0; done < n; done += CHUNK)
+        {
+            size_t count = std::min(CHUNK, n - done);
+            lookup(x + (int)done, y, count, indices);
+            if (r.opaque && alpha >= 255)
+            {
+                for (size_t i = 0; i < count; i++)
+                {
+                    dst[done + i] = r.colors[indices[i]];
+                }
+                continue;
+            }
+            for (size_t i = 0; i < count; i++)
+            {
+                colors[i] = r.colors[indices[i]];
+                std::memcpy(alphas + 3 * i, r.alphas + 3 * indices[i], 3);
+            }
+            blend_shaded_span(dst + done, colors, alphas, count, alpha);
+        }
+    }
+
+    void Paint::transform(const Affine &m)
+    {
+        if (gradient)
+        {
+            gradient = std::make_shared<Gradient>(gradient->transformed(m));
+        }
+    }
+}
@@ -0,0 +1,117 @@
+//! @file Gradient.hpp
+#ifndef __svg_Gradient_hpp__
+#define __svg_Gradient_hpp__
+
+#include "Color.hpp"
+#include "Point.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace svg
+{
+    //! Color stop of a gradient (<stop>).
+    struct GradientStop
+    {
+        //! Position along the gradient, in [0, 1].
+        double offset;
+        //! Color (stop-color).
+        Color color;
+        //! Opacity in [0, 1] (stop-opacity).
+        double opacity;
+    };
+
+    //! Gradient colors sampled at SIZE evenly spaced offsets, shared by all
+    //! the copies of a gradient.
+    struct GradientRamp
+    {
+        //! Number of samples.
+        static const int SIZE = 256;
+        //! Colors.
+        Color colors[SIZE];
+        //! Alphas in [0, 255], repeated for each color component.
+        unsigned char alphas[3 * SIZE];
+        //! True if all the alphas are 255.
+        bool opaque;
+    };
+
+    //! Linear or radial gradient, positioned in pixels. The gradient is padded:
+    //! points before the first stop or after the last one take its color.
+    class Gradient
+    {
+    public:
+        //! Linear gradient, with offset 0 at p0, 1 at p1, and colors constant
+        //! along lines perpendicular to p0-p1. If p0 = p1, the last stop color is used.
+        //! @param p0 Start point.
+        //! @param p1 End point.
+        //! @param stops Color stops, in order.
+        //! @return The gradient.
+        static Gradient linear(const Vertex &p0, const Vertex &p1, const std::vector<GradientStop> &stops);
+        //! Radial gradient, with offset 0 at the center and 1 on the circle of
+        //! radius r. If r = 0, the last stop color is used.
+        //! @param center Center.
+        //! @param r Radius.
+        //! @param stops Color stops, in order.
+        //! @return The gradient.
+        static Gradient radial(const Vertex &center, double r, const std::vector<GradientStop> &stops);
+
+        //! Gradient moved by an affine map, like the shape it fills.
+        //! @param m Map.
+        //! @return The transformed gradient, sharing the ramp.
+        Gradient transformed(const Affine &m) const;
+        //! Check if all the gradient colors are opaque.
+        //! @return True if opaque.
+        bool opaque() const;
+        //! Blend the gradient over pixels [x, x + n) of row y, sampled at pixel
+        //! centers. Offsets are computed and looked up in the ramp four pixels
+        //! at a time with SSE when available.
+        //! @param dst First pixel of the run.
+        //! @param x X of the first pixel.
+        //! @param y Row.
+        //! @param n Number of pixels.
+        //! @param alpha Opacity in [0, 255] applied over the gradient's own.
+        void shade_span(Color *dst, int x, int y, size_t n, int alpha) const;
+
+    private:
+        //! Gradient type.
+        enum class Type
+        {
+            Linear,
+            Radial
+        };
+        //! Constructor.
+        //! @param type Type.
+        //! @param to_gradient Map from pixels to gradient space.
+        //! @param stops Color stops.
+        Gradient(Type type, const Affine &to_gradient, const std::vector<GradientStop> &stops);
+        //! Ramp indices of n pixels of row y starting at x. Indices are
+        //! written four at a time, so the output must have room for n rounded up to 4.
+        void lookup(int x, int y, size_t n, int *indices) const;
+
+        //! Gradient type.
+        Type type;
+        //! Map from pixels to gradient space (u, v), where the offset is u
+        //! (linear) or the length of (u, v) (radial).
+        Affine to_gradient;
+        //! Sampled colors.
+        std::shared_ptr<const GradientRamp> ramp;
+    };
+
+    //! Fill paint: a solid color, or a gradient.
+    struct Paint
+    {
+        //! Solid color, used without a gradient.
+        Color color;
+        //! Gradient, if any.
+        std::shared_ptr<const Gradient> gradient;
+
+        //! Solid paint (implicit, so colors can be passed where paints are expected).
+        //! @param color Color.
+        Paint(const Color &color) : color(color) {}
+        //! Move the gradient, if any, with the shape it fills.
+        //! @param m Affine map.
+        void transform(const Affine &m);
+    };
+}
+#endif
@@ -0,0 +1,174 @@
+#include "Optimize.hpp"
+#include "Trace.hpp"
+
+namespace svg
+{
+    namespace
+    {
+        //! Number of shapes making up an element.
+        size_t count_shapes(const SVGElement *element)
+        {
+            std::vector<const SVGElement *> shapes;
+            element->collect_shapes(shapes);
+            return shapes.size();
+        }
+
+        //! Polygon (or rectangle) that can be drawn in a PolygonBatch, or null.
+        const Polygon *batchable(const SVGElement *element)
+        {
+            const Polygon *polygon = dynamic_cast<const Polygon *>(element);
+            if (polygon == nullptr || polygon->get_opacity() != 1.0 || polygon->has_gradient())
+            {
+                return nullptr;
+            }
+            return polygon;
+        }
+
+        class Optimizer
+        {
+        public:
+            Optimizer(int width, int height, bool antialiasing, OptimizeStats &stats)
+                : image({0, 0, to_fixed(width - 1), to_fixed(height - 1)}), antialiasing(antialiasing), stats(stats)
+            {
+            }
+
+            //! Simplify a list of elements: the top-level elements, or the
+            //! members of a translucent group.
+            void simplify(std::vector<SVGElement *> &elements, bool top)
+            {
+                std::vector<SVGElement *> out;
+                out.reserve(elements.size());
+                flatten(elements, out);
+                elements.swap(out);
+                if (top)
+                {
+                    drop_covered(elements);
+                }
+                if (!antialiasing)
+                {
+                    make_batches(elements);
+                }
+            }
+
+        private:
+            //! Append the elements to out, without opaque groups and the
+            //! elements that cannot change the image. The input elements are
+            //! moved to out or deleted.
+            void flatten(const std::vector<SVGElement *> &elements, std::vector<SVGElement *> &out)
+            {
+                for (SVGElement *element : elements)
+                {
+                    if (element->empty())
+                    {
+                        stats.empty_removed += count_shapes(element);
+                        delete element;
+                        continue;
+                    }
+                    Group *group = dynamic_cast<Group *>(element);
+                    if (group != nullptr)
+                    {
+                        std::vector<SVGElement *> &members = group->get_elements();
+                        if (group->get_opacity() == 1.0)
+                        {
+                            // An opaque group draws its elements in turn.
+                            flatten(members, out);
+                            members.clear();
+                            delete group;
+                            stats.groups_flattened++;
+                            continue;
+                        }
+                        simplify(members, false);
+                        if (members.empty())
+                        {
+                            delete group;
+                            continue;
+                        }
+                        out.push_back(group);
+                        continue;
+                    }
+                    if (!element->visible(image, 0))
+                    {
+                        stats.offscreen_removed++;
+                        delete element;
+                        continue;
+                    }
+                    out.push_back(element);
+                }
+            }
+
+            //! Remove the elements drawn before the last one covering the image.
+            void drop_covered(std::vector<SVGElement *> &elements)
+            {
+                size_t cover = elements.size();
+                while (cover > 0 && !elements[cover - 1]->covers(image, antialiasing))
+                {
+                    cover--;
+                }
+                if (cover <= 1)
+                {
+                    return;
+                }
+                for (size_t i = 0; i + 1 < cover; i++)
+                {
+                    stats.covered_removed += count_shapes(elements[i]);
+                    delete elements[i];
+                }
+                elements.erase(elements.begin(), elements.begin() + (cover - 1));
+            }
+
+            //! Replace runs of batchable polygons of the same color by batches.
+            void make_batches(std::vector<SVGElement *> &elements)
+            {
+                size_t n = 0;
+                for (size_t i = 0; i < elements.size();)
+                {
+                    const Polygon *first = batchable(elements[i]);
+                    size_t end = i + 1;
+                    if (first != nullptr)
+                    {
+                        Color c = first->get_fill();
+                        for (; end < elements.size(); end++)
+                        {
+                            const Polygon *next = batchable(elements[end]);
+                            if (next == nullptr)
+                            {
+                                break;
+                            }
+                            Color d = next->get_fill();
+                            if (d.red != c.red || d.green != c.green || d.blue != c.blue)
+                            {
+                                break;
+                            }
+                        }
+                    }
+                    if (end - i < 2)
+                    {
+                        elements[n++] = elements[i++];
+                        continue;
+                    }
+                    std::vector<SVGElement *> run(elements.begin() + i, elements.begin() + end);
+                    elements[n++] = new PolygonBatch(run, first->get_fill());
+                    stats.batched += run.size();
+                    stats.batches++;
+                    i = end;
+                }
+                elements.resize(n);
+            }
+
+            //! Image area, in pixel centers.
+            BoundingBox image;
+            //! Anti-aliased drawing.
+            bool antialiasing;
+            //! Statistics.
+            OptimizeStats &stats;
+        };
+    }
+
+    OptimizeStats optimize_scene(std::vector<SVGElement *> &elements, int width, int height, bool antialiasing)
+    {
+        TRACE_SCOPE("optimize", "convert");
+        OptimizeStats stats;
+        Optimizer(width, height, antialiasing, stats).simplify(elements, true);
+        return stats;
+    }
+}
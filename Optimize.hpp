@@ -0,0 +1,46 @@
+//! @file Optimize.hpp
+#ifndef __svg_Optimize_hpp__
+#define __svg_Optimize_hpp__
+
+#include "SVGElements.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace svg
+{
+    //! What optimize_scene changed. Removed elements are counted as shapes
+    //! (see SVGElement::collect_shapes), so a removed group counts its members.
+    struct OptimizeStats
+    {
+        //! Opaque groups replaced by their elements.
+        size_t groups_flattened = 0;
+        //! Shapes removed because they paint nothing (SVGElement::empty).
+        size_t empty_removed = 0;
+        //! Shapes removed because they lie outside the image.
+        size_t offscreen_removed = 0;
+        //! Shapes removed because a later element covers the whole image.
+        size_t covered_removed = 0;
+        //! Polygons and rectangles drawn in batches.
+        size_t batched = 0;
+        //! Batches made (each one replaces at least two fill calls by one).
+        size_t batches = 0;
+    };
+
+    //! Simplify the elements of a scene, in output pixel coordinates, without
+    //! changing the image drawn from them:
+    //! - groups with full opacity are replaced by their elements (translucent
+    //!   groups are kept, as they are composited as layers);
+    //! - elements that paint nothing or lie outside the image are removed;
+    //! - everything drawn before the last element covering the whole image
+    //!   (SVGElement::covers) is removed;
+    //! - without anti-aliasing, runs of consecutive opaque polygons and
+    //!   rectangles of the same solid color become one PolygonBatch.
+    //! @param elements Elements, in paint order; removed elements are deleted.
+    //! @param width Image width.
+    //! @param height Image height.
+    //! @param antialiasing True if the scene is drawn with anti-aliasing.
+    //! @return What was changed.
+    OptimizeStats optimize_scene(std::vector<SVGElement *> &elements, int width, int height, bool antialiasing);
+}
+#endif
@@ -1,10 +1,20 @@
 #include "PNGImage.hpp"
+#include "Blend.hpp"
+#include "Trace.hpp"
 
 #include <stdexcept>
 #include <cmath>
 #include <cstring>
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define STBI_ONLY_PNG
 #define STB_IMAGE_IMPLEMENTATION
@@ -14,7 +24,315 @@
 
 namespace svg
 {
+    namespace
+    {
+        //! Rows sampled per pixel row by the anti-aliased rotated ellipse, so
+        //! that its vertical resolution is the 1/16 pixel deviation allowed to
+        //! the flattened curves.
+        const int ELLIPSE_SUBROWS = 16;
+
+        //! Add a horizontal span [x0, x1] with a weight to a coverage row, in
+        //! the running-sum form of fill_antialiased: the pixels it overlaps
+        //! get the weight times the overlap. Coordinates are relative to the
+        //! accumulation box, where pixel x covers [x, x+1].
+        void accumulate_span(double x0, double x1, float weight, float *acc, int box_w)
+        {
+            x0 = std::max(x0, 0.0);
+            x1 = std::min(x1, (double)box_w);
+            if (x0 >= x1)
+            {
+                return;
+            }
+            int i0 = (int)x0, i1 = (int)x1;
+            float f0 = (float)(x0 - i0), f1 = (float)(x1 - i1);
+            acc[i0] += weight * (1 - f0);
+            acc[i0 + 1] += weight * f0;
+            acc[i1] -= weight * (1 - f1);
+            acc[i1 + 1] -= weight * f1;
+        }
+
+        //! Bresenham line rasterization: calls plot(x, y) for each pixel from a to b.
+        template <typename Plot>
+        void bresenham(const Point &a, const Point &b, Plot plot)
+        {
+            int x_from = a.x;
+            int y_from = a.y;
+            int x_to = b.x;
+            int y_to = b.y;
+            int dy = y_to - y_from;
+            int dx = x_to - x_from;
+            int step_x = 1, step_y = 1;
+            if (dy < 0)
+            {
+                dy = -dy;
+                step_y = -1;
+            }
+            if (dx < 0)
+            {
+                dx = -dx;
+                step_x = -1;
+            }
+            dy *= 2;
+            dx *= 2;
+            plot(x_from, y_from);
+            if (dx > dy)
+            {
+                int fraction = dy - (dx / 2);
+                while (x_from != x_to)
+                {
+                    if (fraction >= 0)
+                    {
+                        y_from += step_y;
+                        fraction -= dx;
+                    }
+                    x_from += step_x;
+                    fraction += dy;
+                    plot(x_from, y_from);
+                }
+            }
+            else
+            {
+                int fraction = dx - (dy >> 1);
+                while (y_from != y_to)
+                {
+                    if (fraction >= 0)
+                    {
+                        x_from += step_x;
+                        fraction -= dy;
+                    }
+                    y_from += step_y;
+                    fraction += dx;
+                    plot(x_from, y_from);
+                }
+            }
+        }
+    }
+
+    namespace
+    {
+        //! Crossing of the non-horizontal edge a-b with the row at fixed-point y,
+        //! rounded exactly to the nearest pixel (halves up, like fixed_round).
+        int round_crossing(const FixedPoint &a, const FixedPoint &b, fixed_value row)
+        {
+            // x = a.x + (row - a.y) * (b.x - a.x) / (b.y - a.y), as num / den pixels.
+            int64_t den = (int64_t)(b.y - a.y) * FIXED_ONE;
+            int64_t num = (int64_t)a.x * (b.y - a.y) + (int64_t)(row - a.y) * (b.x - a.x);
+            if (den < 0)
+            {
+                den = -den;
+                num = -num;
+            }
+            // floor((num + den / 2) / den)
+            int64_t n = 2 * num + den, d = 2 * den;
+            int64_t q = n / d;
+            return (int)(n % d < 0 ? q - 1 : q);
+        }
+    }
+
+    namespace
+    {
+        //! Map a new temporary file of the given size; the file is removed once unmapped.
+        Color *map_temporary_file(size_t bytes)
+        {
+            const char *dir = std::getenv("TMPDIR");
+            std::string path = std::string(dir != nullptr && *dir != '\0' ? dir : "/tmp") + "/svgtopng-XXXXXX";
+            int fd = ::mkstemp(&path[0]);
+            if (fd < 0)
+            {
+                throw std::runtime_error(path + ": could not create pixel file");
+            }
+            // The file is only reachable through the mapping from now on.
+            ::unlink(path.c_str());
+            // Reserve the blocks now: running out of disk space while drawing
+            // would otherwise raise SIGBUS.
+            void *p = MAP_FAILED;
+            if (::posix_fallocate(fd, 0, (off_t)bytes) == 0)
+            {
+                p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            ::close(fd);
+            if (p == MAP_FAILED)
+            {
+                throw std::runtime_error(path + ": could not map " + std::to_string(bytes) + " bytes of pixels");
+            }
+            return (Color *)p;
+        }
+
+        //! Luma of n pixels, with the BT.601 weights in 8-bit fixed point
+        //! (summing to 256, so that white stays 255).
+        void to_gray(const Color *src, size_t n, unsigned char *dst)
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                dst[i] = (unsigned char)((77 * src[i].red + 150 * src[i].green + 29 * src[i].blue + 128) >> 8);
+            }
+        }
+
+        //! PNG file written chunk by chunk, with the image data as a zlib stream
+        //! of stored (uncompressed) deflate blocks, so that memory use does not
+        //! depend on the image size.
+        class StoredPNGWriter
+        {
+        public:
+            StoredPNGWriter(const std::string &file_name, int width, int height, PixelFormat format)
+                : file_name_(file_name), file_(std::fopen(file_name.c_str(), "wb"))
+            {
+                if (file_ == nullptr)
+                {
+                    throw std::runtime_error(file_name + ": could not open for writing");
+                }
+                const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+                put(signature, 8);
+                unsigned char header[13];
+                put_u32(header, width);
+                put_u32(header + 4, height);
+                // 8-bit RGB or grayscale, deflate, adaptive filtering, no interlace.
+                const unsigned char layout[5] = {8, (unsigned char)(format == PixelFormat::Gray ? 0 : 2), 0, 0, 0};
+                std::memcpy(header + 8, layout, 5);
+                write_chunk("IHDR", header, 13);
+                // zlib header: deflate with a 32K window, no dictionary.
+                idat_.push_back(0x78);
+                idat_.push_back(0x01);
+            }
+            ~StoredPNGWriter()
+            {
+                std::fclose(file_);
+            }
+
+            //! Append image data (filter byte and pixels of each row).
+            void write(const unsigned char *data, size_t n)
+            {
+                update_adler(data, n);
+                while (n > 0)
+                {
+                    size_t count = std::min(n, MAX_BLOCK - block_.size());
+                    block_.insert(block_.end(), data, data + count);
+                    data += count;
+                    n -= count;
+                    if (block_.size() == MAX_BLOCK)
+                    {
+                        flush_block(false);
+                    }
+                }
+            }
+
+            //! Write the last block, the checksum and the end of the file.
+            void finish()
+            {
+                flush_block(true);
+                unsigned char adler[4];
+                put_u32(adler, (adler_b_ << 16) | adler_a_);
+                idat_.insert(idat_.end(), adler, adler + 4);
+                write_chunk("IDAT", idat_.data(), idat_.size());
+                write_chunk("IEND", nullptr, 0);
+                if (std::fflush(file_) != 0)
+                {
+                    throw std::runtime_error(file_name_ + ": write error");
+                }
+            }
+
+        private:
+            //! Largest stored block.
+            static const size_t MAX_BLOCK = 65535;
+            //! IDAT chunks are written once they reach this size.
+            static const size_t CHUNK_SIZE = 1 << 20;
+
+            static void put_u32(unsigned char *out, uint32_t v)
+            {
+                out[0] = (unsigned char)(v >> 24);
+                out[1] = (unsigned char)(v >> 16);
+                out[2] = (unsigned char)(v >> 8);
+                out[3] = (unsigned char)v;
+            }
+
+            static uint32_t crc32(uint32_t crc, const unsigned char *data, size_t n)
+            {
+                struct Table
+                {
+                    uint32_t v[256];
+                    Table()
+                    {
+                        for (uint32_t i = 0; i < 256; i++)
+                        {
+                            uint32_t c = i;
+                            for (int k = 0; k < 8; k++)
+                            {
+                                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                            }
+                            v[i] = c;
+                        }
+                    }
+                };
+                static const Table table;
+                for (size_t i = 0; i < n; i++)
+                {
+                    crc = table.v[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+                }
+                return crc;
+            }
+
+            void update_adler(const unsigned char *data, size_t n)
+            {
+                while (n > 0)
+                {
+                    // 5552 bytes is the most that cannot overflow before the modulo.
+                    size_t count = std::min<size_t>(n, 5552);
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        adler_a_ += data[i];
+                        adler_b_ += adler_a_;
+                    }
+                    adler_a_ %= 65521;
+                    adler_b_ %= 65521;
+                    data += count;
+                    n -= count;
+                }
+            }
+
+            void flush_block(bool final)
+            {
+                size_t n = block_.size();
+                const unsigned char header[5] = {(unsigned char)(final ? 1 : 0),
+                                                 (unsigned char)n, (unsigned char)(n >> 8),
+                                                 (unsigned char)~n, (unsigned char)(~n >> 8)};
+                idat_.insert(idat_.end(), header, header + 5);
+                idat_.insert(idat_.end(), block_.begin(), block_.end());
+                block_.clear();
+                if (idat_.size() >= CHUNK_SIZE && !final)
+                {
+                    write_chunk("IDAT", idat_.data(), idat_.size());
+                    idat_.clear();
+                }
+            }
+
+            void write_chunk(const char *type, const unsigned char *data, size_t n)
+            {
+                unsigned char length[4], crc[4];
+                put_u32(length, (uint32_t)n);
+                put(length, 4);
+                put((const unsigned char *)type, 4);
+                put(data, n);
+                put_u32(crc, crc32(crc32(0xFFFFFFFFu, (const unsigned char *)type, 4), data, n) ^ 0xFFFFFFFFu);
+                put(crc, 4);
+            }
+
+            void put(const unsigned char *data, size_t n)
+            {
+                if (n > 0 && std::fwrite(data, 1, n, file_) != n)
+                {
+                    throw std::runtime_error(file_name_ + ": write error");
+                }
+            }
+
+            std::string file_name_;
+            FILE *file_;
+            std::vector<unsigned char> block_, idat_;
+            uint32_t adler_a_ = 1, adler_b_ = 0;
+        };
+    }
+
     PNGImage::PNGImage(const std::string &png_file_name)
+        : mapped_bytes_(0), counted_run_(0), antialiasing_(false), backdrop_count_(0)
     {
         int dummy;
         pixels_ = (Color *)::stbi_load(png_file_name.c_str(),
@@ -24,29 +342,150 @@ namespace svg
         {
             throw std::runtime_error(png_file_name + ": could not load image!");
         }
+        capacity_ = (size_t)width_ * height_;
+        count_pixels();
     }
-    PNGImage::PNGImage(int w, int h)
+    PNGImage::PNGImage(int w, int h, PixelStorage storage)
+        : width_(0), height_(0), pixels_(nullptr), capacity_(0), mapped_bytes_(0), counted_run_(0),
+          antialiasing_(false), backdrop_count_(0)
     {
         assert(w > 0 && h > 0);
-        size_t sz = w * h * sizeof(Color);
-        pixels_ = (Color *)::stbi__malloc(sz);
+        allocate((size_t)w * (size_t)h, storage);
+        reset(w, h);
+    }
+    void PNGImage::allocate(size_t count, PixelStorage storage)
+    {
+        release();
+        size_t sz = count * sizeof(Color);
+        if (storage == PixelStorage::File)
+        {
+            pixels_ = map_temporary_file(sz);
+            mapped_bytes_ = sz;
+        }
+        else
+        {
+            pixels_ = (Color *)::stbi__malloc(sz);
+            if (pixels_ == nullptr)
+            {
+                throw std::runtime_error("could not allocate " + std::to_string(sz) + " bytes of pixels");
+            }
+        }
+        capacity_ = count;
+        count_pixels();
+    }
+    void PNGImage::count_pixels()
+    {
+        // The pixels come from stb's malloc or a file mapping, which the
+        // operator new replacements of the allocation profiler do not see.
+        if (alloc::enabled())
+        {
+            size_t sz = capacity_ * sizeof(Color);
+            counted_run_ = alloc::on_alloc(sz, sz);
+        }
+    }
+    void PNGImage::release()
+    {
+        if (counted_run_ != 0 && alloc::enabled())
+        {
+            alloc::on_free(capacity_ * sizeof(Color), counted_run_);
+        }
+        counted_run_ = 0;
+        if (mapped_bytes_ > 0)
+        {
+            ::munmap(pixels_, mapped_bytes_);
+            mapped_bytes_ = 0;
+        }
+        else
+        {
+            stbi_image_free(pixels_);
+        }
+        pixels_ = nullptr;
+        capacity_ = 0;
+        width_ = height_ = 0;
+    }
+    void PNGImage::reset(int w, int h)
+    {
+        assert(w > 0 && h > 0);
+        size_t count = (size_t)w * (size_t)h;
+        if (count > capacity_)
+        {
+            allocate(count, storage());
+        }
         width_ = w;
         height_ = h;
+        size_t sz = count * sizeof(Color);
+        if (mapped_bytes_ > 0)
+        {
+            // The white background is written front to back.
+            ::madvise(pixels_, sz, MADV_SEQUENTIAL);
+        }
         ::memset(pixels_, 0xFF, sz);
+        if (mapped_bytes_ > 0)
+        {
+            // Shapes are drawn in any order.
+            ::madvise(pixels_, sz, MADV_NORMAL);
+        }
     }
-    void PNGImage::save(const std::string &png_file_name) const
+    PixelStorage PNGImage::storage() const
     {
-        ::stbi_write_png(png_file_name.c_str(),
-                         width_,
-                         height_,
-                         3,
-                         pixels_,
-                         width_ * 3);
+        return mapped_bytes_ > 0 ? PixelStorage::File : PixelStorage::Memory;
+    }
+    void PNGImage::save(const std::string &png_file_name, PixelFormat format) const
+    {
+        TRACE_SCOPE("PNGImage::save", "encode");
+        // stb_image_write encodes the whole image in memory, with int sizes.
+        if (mapped_bytes_ > 0 || ((size_t)width_ * 3 + 1) * height_ > (size_t)INT_MAX / 2)
+        {
+            save_uncompressed(png_file_name, format);
+            return;
+        }
+        if (format == PixelFormat::Gray)
+        {
+            std::vector<unsigned char> gray((size_t)width_ * height_);
+            to_gray(pixels_, gray.size(), gray.data());
+            if (!::stbi_write_png(png_file_name.c_str(), width_, height_, 1, gray.data(), width_))
+            {
+                throw std::runtime_error(png_file_name + ": could not write image");
+            }
+            return;
+        }
+        if (!::stbi_write_png(png_file_name.c_str(),
+                              width_,
+                              height_,
+                              3,
+                              pixels_,
+                              width_ * 3))
+        {
+            throw std::runtime_error(png_file_name + ": could not write image");
+        }
+    }
+
+    void PNGImage::save_uncompressed(const std::string &png_file_name, PixelFormat format) const
+    {
+        if (mapped_bytes_ > 0)
+        {
+            ::madvise(pixels_, mapped_bytes_, MADV_SEQUENTIAL);
+        }
+        StoredPNGWriter writer(png_file_name, width_, height_, format);
+        const unsigned char no_filter = 0;
+        std::vector<unsigned char> gray(format == PixelFormat::Gray ? width_ : 0);
+        for (int y = 0; y < height_; y++)
+        {
+            writer.write(&no_filter, 1);
+            if (format == PixelFormat::Gray)
+            {
+                to_gray(row(y), width_, gray.data());
+                writer.write(gray.data(), gray.size());
+                continue;
+            }
+            writer.write((const unsigned char *)row(y), (size_t)width_ * sizeof(Color));
+        }
+        writer.finish();
     }
 
     PNGImage::~PNGImage()
     {
-        stbi_image_free(pixels_);
+        release();
     }
 
     int PNGImage::width() const
@@ -61,126 +500,500 @@ namespace svg
     {
         assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        return row(y)[x];
     }
     Color PNGImage::at(int x, int y) const
     {
         assert(x >= 0 && x < width_);
         assert(y >= 0 && y < height_);
-        return pixels_[y * width_ + x];
+        return row(y)[x];
+    }
+    void PNGImage::set_antialiasing(bool enabled)
+    {
+        antialiasing_ = enabled;
+    }
+    bool PNGImage::antialiasing() const
+    {
+        return antialiasing_;
+    }
+
+    void PNGImage::draw_line(const FixedPoint &fa, const FixedPoint &fb, const Color &c, int alpha)
+    {
+        if (antialiasing_)
+        {
+            // 1-pixel wide quad, extended by half a pixel at each end so that
+            // it covers the same pixels as the aliased line.
+            Vertex a = fa.vertex(), b = fb.vertex();
+            double dx = b.x - a.x, dy = b.y - a.y;
+            double len = std::sqrt(dx * dx + dy * dy);
+            if (len == 0)
+            {
+                dx = 0.5;
+                dy = 0;
+            }
+            else
+            {
+                dx *= 0.5 / len;
+                dy *= 0.5 / len;
+            }
+            single_contour().assign({{a.x - dx - dy, a.y - dy + dx},
+                                     {b.x + dx - dy, b.y + dy + dx},
+                                     {b.x + dx + dy, b.y + dy - dx},
+                                     {a.x - dx + dy, a.y - dy - dx}});
+            fill_antialiased(contours_, c, alpha);
+            return;
+        }
+        // Aliased lines join the pixels nearest to the end points.
+        Point a = fa.round(), b = fb.round();
+        if (alpha >= 255)
+        {
+            bresenham(a, b, [&](int x, int y)
+                      { if (contains(x, y)) at(x, y) = c; });
+        }
+        else
+        {
+            // A single line never visits a pixel twice.
+            bresenham(a, b, [&](int x, int y)
+                      { if (contains(x, y)) blend_pixel(at(x, y), c, alpha); });
+        }
     }
-    void PNGImage::draw_line(const Point &a, const Point &b, const Color &c)
+
+    void PNGImage::draw_polyline(const std::vector<FixedPoint> &points, const Color &c, int alpha)
     {
-        //  Bresenham Algorithm.
-        int x_from = a.x;
-        int y_from = a.y;
-        int x_to = b.x;
-        int y_to = b.y;
-        int dy = y_to - y_from;
-        int dx = x_to - x_from;
-        int step_x = 1, step_y = 1;
-        if (dy < 0)
+        if (antialiasing_ || alpha >= 255)
         {
-            dy = -dy;
-            step_y = -1;
+            for (size_t i = 0; i + 1 < points.size(); i++)
+            {
+                draw_line(points[i], points[i + 1], c, alpha);
+            }
+            return;
         }
-        if (dx < 0)
+        // Translucent: collect all pixels first so that the pixels shared by
+        // consecutive segments are blended only once.
+        spans_.clear();
+        for (size_t i = 0; i + 1 < points.size(); i++)
         {
-            dx = -dx;
-            step_x = -1;
+            bresenham(points[i].round(), points[i + 1].round(), [&](int x, int y)
+                      { add_span(y, x, x); });
         }
-        dy *= 2;
-        dx *= 2;
-        at(x_from, y_from) = c;
-        if (dx > dy)
+        fill_spans(c, alpha);
+    }
+
+    void PNGImage::draw_polygon(const std::vector<FixedPoint> &points, const Paint &c, int alpha)
+    {
+        if (antialiasing_)
         {
-            int fraction = dy - (dx / 2);
-            while (x_from != x_to)
+            Contour &vertices = single_contour();
+            for (const FixedPoint &p : points)
             {
-                if (fraction >= 0)
-                {
-                    y_from += step_y;
-                    fraction -= dx;
-                }
-                x_from += step_x;
-                fraction += dy;
-                at(x_from, y_from) = c;
+                vertices.push_back(p.vertex());
             }
+            fill_antialiased(contours_, c, alpha);
+            return;
         }
-        else
+        spans_.clear();
+        polygon_spans(points);
+        fill_spans(c, alpha);
+    }
+
+    void PNGImage::draw_polygons(const std::vector<std::vector<FixedPoint>> &polygons, const Color &c)
+    {
+        if (antialiasing_)
         {
-            int fraction = dx - (dy >> 1);
-            while (y_from != y_to)
+            // Coverage of pixels shared by two polygons would be blended once.
+            for (const std::vector<FixedPoint> &points : polygons)
             {
-                if (fraction >= 0)
-                {
-                    x_from += step_x;
-                    fraction -= dy;
-                }
-                y_from += step_y;
-                fraction += dx;
-                at(x_from, y_from) = c;
+                draw_polygon(points, c);
             }
+            return;
         }
+        spans_.clear();
+        for (const std::vector<FixedPoint> &points : polygons)
+        {
+            polygon_spans(points);
+        }
+        fill_merged_spans(c, 255);
     }
 
-    void PNGImage::draw_polygon(const std::vector<Point> &points, const Color &c)
+    void PNGImage::draw_convex_polygon(const std::vector<FixedPoint> &points, const Paint &c, int alpha)
     {
-        int x_min = width(), x_max = 0, y_min = height(), y_max = 0;
-        for (const Point &p : points)
+        if (antialiasing_ || points.size() < 3)
+        {
+            draw_polygon(points, c, alpha);
+            return;
+        }
+        // Every row crosses the boundary at a left and a right point only, so
+        // the general rule (pairing the sorted crossings) reduces to filling
+        // [min, max] of the crossings of the two chains from top to bottom.
+        size_t n = points.size(), top = 0, bottom = 0;
+        for (size_t i = 1; i < n; i++)
+        {
+            if (points[i].y < points[top].y)
+            {
+                top = i;
+            }
+            if (points[i].y > points[bottom].y)
+            {
+                bottom = i;
+            }
+        }
+        bool opaque = alpha >= 255;
+        spans_.clear();
+        size_t fwd = top, bwd = top;
+        int row_end = std::min(height_, fixed_ceil(points[bottom].y));
+        for (int y = std::max(0, fixed_ceil(points[top].y)); y < row_end; y++)
+        {
+            fixed_value row = to_fixed(y);
+            // Advance each chain to its first non-horizontal edge reaching the row.
+            size_t fwd_next = (fwd + 1) % n;
+            while (points[fwd_next].y < row || points[fwd_next].y == points[fwd].y)
+            {
+                fwd = fwd_next;
+                fwd_next = (fwd + 1) % n;
+            }
+            size_t bwd_next = (bwd + n - 1) % n;
+            while (points[bwd_next].y < row || points[bwd_next].y == points[bwd].y)
+            {
+                bwd = bwd_next;
+                bwd_next = (bwd + n - 1) % n;
+            }
+            int xa = round_crossing(points[fwd], points[fwd_next], row);
+            int xb = round_crossing(points[bwd], points[bwd_next], row);
+            if (xa == xb)
+            {
+                continue;
+            }
+            if (opaque)
+            {
+                fill_row(y, std::min(xa, xb), std::max(xa, xb), c, alpha);
+            }
+            else
+            {
+                add_span(y, std::min(xa, xb), std::max(xa, xb));
+            }
+        }
+        // Outline.
+        for (size_t i = 0; i < n; i++)
+        {
+            if (opaque && !c.gradient)
+            {
+                bresenham(points[i].round(), points[(i + 1) % n].round(), [&](int x, int y)
+                          { if (contains(x, y)) at(x, y) = c.color; });
+            }
+            else if (opaque)
+            {
+                bresenham(points[i].round(), points[(i + 1) % n].round(), [&](int x, int y)
+                          { fill_row(y, x, x, c, alpha); });
+            }
+            else
+            {
+                bresenham(points[i].round(), points[(i + 1) % n].round(), [&](int x, int y)
+                          { add_span(y, x, x); });
+            }
+        }
+        if (!opaque)
+        {
+            fill_spans(c, alpha);
+        }
+    }
+
+    void PNGImage::polygon_spans(const std::vector<FixedPoint> &points)
+    {
+        fixed_value y_min = to_fixed(height()), y_max = 0;
+        for (const FixedPoint &p : points)
         {
-            x_min = std::min(x_min, p.x);
-            x_max = std::max(x_max, p.x);
             y_min = std::min(y_min, p.y);
             y_max = std::max(y_max, p.y);
         }
 
-        std::vector<double> seg;
-        for (int y = y_min; y < y_max; y++)
+        // Rows are sampled at their centers (integer y) and crossings are
+        // rounded to the nearest pixel exactly, in integer arithmetic.
+        std::vector<int> &seg = row_crossings_;
+        seg.clear();
+        int row_end = std::min(height_, fixed_ceil(y_max));
+        for (int y = std::max(0, fixed_ceil(y_min)); y < row_end; y++)
         {
+            fixed_value row = to_fixed(y);
             for (size_t i = 0; i < points.size(); i++)
             {
-                Point a = points[i];
-                Point b = points[(i + 1) % points.size()];
-                if (y < std::min(a.y, b.y) || y > std::max(a.y, b.y))
+                FixedPoint a = points[i];
+                FixedPoint b = points[(i + 1) % points.size()];
+                if (row < std::min(a.y, b.y) || row > std::max(a.y, b.y))
                 {
                     continue;
                 }
                 if (a.y != b.y)
                 {
-                    double x_inters = (double)(y - a.y) * (b.x - a.x) / (double)(b.y - a.y) + a.x;
-                    seg.push_back(x_inters);
+                    seg.push_back(round_crossing(a, b, row));
                 }
             }
             std::sort(seg.begin(), seg.end());
             size_t i_s = 0;
             while ((i_s + 1) < seg.size())
             {
-                Point a = {(int)round(seg.at(i_s)), y};
-                Point b = {(int)round(seg.at(i_s + 1)), y};
-                if (a.x == b.x)
+                int a = seg[i_s];
+                int b = seg[i_s + 1];
+                if (a == b)
                 {
                     i_s++;
                 }
                 else
                 {
-                    draw_line(a, b, c);
+                    add_span(y, a, b);
                     i_s += 2;
                 }
             }
             seg.clear();
         }
+        // Outline.
         for (size_t i = 0; i < points.size(); i++)
         {
-            draw_line(points[i], points[(i + 1) % points.size()], c);
+            bresenham(points[i].round(), points[(i + 1) % points.size()].round(), [&](int x, int y)
+                      { add_span(y, x, x); });
+        }
+    }
+
+    void PNGImage::fill_spans(const Paint &c, int alpha)
+    {
+        if (alpha >= 255)
+        {
+            for (const Span &s : spans_)
+            {
+                fill_row(s.y, s.x0, s.x1, c, alpha);
+            }
+            return;
+        }
+        fill_merged_spans(c, alpha);
+    }
+
+    void PNGImage::fill_merged_spans(const Paint &c, int alpha)
+    {
+        if (spans_.empty())
+        {
+            return;
+        }
+        // Merge overlapping spans so that every pixel is blended once: bucket
+        // the spans by row (counting sort), then sort each row's few spans by x.
+        int y_min = spans_[0].y, y_max = y_min;
+        for (const Span &s : spans_)
+        {
+            y_min = std::min(y_min, s.y);
+            y_max = std::max(y_max, s.y);
+        }
+        row_starts_.assign(y_max - y_min + 2, 0);
+        for (const Span &s : spans_)
+        {
+            row_starts_[s.y - y_min + 1]++;
+        }
+        for (size_t r = 1; r < row_starts_.size(); r++)
+        {
+            row_starts_[r] += row_starts_[r - 1];
+        }
+        sorted_spans_.resize(spans_.size());
+        for (const Span &s : spans_)
+        {
+            sorted_spans_[row_starts_[s.y - y_min]++] = s;
+        }
+        // row_starts_[r] now holds the end of row r (and the start of row r + 1).
+        size_t begin = 0;
+        for (size_t r = 0; r + 1 < row_starts_.size(); r++)
+        {
+            size_t end = row_starts_[r];
+            Span *row = sorted_spans_.data();
+            // Insertion sort: rows hold a handful of spans.
+            for (size_t i = begin + 1; i < end; i++)
+            {
+                Span s = row[i];
+                size_t j = i;
+                for (; j > begin && row[j - 1].x0 > s.x0; j--)
+                {
+                    row[j] = row[j - 1];
+                }
+                row[j] = s;
+            }
+            for (size_t i = begin; i < end;)
+            {
+                int x0 = row[i].x0, x1 = row[i].x1;
+                for (i++; i < end && row[i].x0 <= x1 + 1; i++)
+                {
+                    x1 = std::max(x1, row[i].x1);
+                }
+                fill_row(row[begin].y, x0, x1, c, alpha);
+            }
+            begin = end;
+        }
+    }
+
+    void PNGImage::fill_row(int y, int x0, int x1, const Paint &c, int alpha)
+    {
+        if (x0 > x1)
+        {
+            std::swap(x0, x1);
+        }
+        if (y < 0 || y >= height_)
+        {
+            return;
+        }
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, width_ - 1);
+        if (x0 <= x1)
+        {
+            paint_span(y, x0, x1 - x0 + 1, c, alpha);
+        }
+    }
+
+    void PNGImage::paint_span(int y, int x, size_t n, const Paint &c, int alpha)
+    {
+        Color *dst = row(y) + x;
+        if (c.gradient)
+        {
+            c.gradient->shade_span(dst, x, y, n, alpha);
+            return;
+        }
+        blend_span(dst, n, c.color, alpha);
+    }
+
+    void PNGImage::add_span(int y, int x0, int x1)
+    {
+        // Rows outside the image are dropped here so that fill_spans only
+        // buckets visible rows.
+        if (y >= 0 && y < height_)
+        {
+            spans_.push_back({y, x0, x1});
+        }
+    }
+
+    void PNGImage::draw_ellipse(const FixedPoint &center, const FixedPoint &radius, const Paint &fill, int alpha)
+    {
+        if (antialiasing_)
+        {
+            // Flatten with a maximum deviation of 1/16 pixel from the true curve.
+            Vertex c = center.vertex(), rad = radius.vertex();
+            double r = std::max(std::max(rad.x, rad.y), 1.0);
+            int n = (int)std::ceil(M_PI / std::acos(1 - std::min(1.0, 0.0625 / r)));
+            n = std::max(8, std::min(n, 4096));
+            Contour &vertices = single_contour();
+            vertices.resize(n);
+            for (int i = 0; i < n; i++)
+            {
+                double angle = 2 * M_PI * i / n;
+                vertices[i] = {c.x + rad.x * std::cos(angle),
+                               c.y + rad.y * std::sin(angle)};
+            }
+            fill_antialiased(contours_, fill, alpha);
+            return;
+        }
+        if (((center.x | center.y | radius.x | radius.y) & (FIXED_ONE - 1)) == 0)
+        {
+            fill_ellipse(center.round(), radius.round(), fill, alpha);
+            return;
+        }
+        // Sub-pixel ellipse: fill the pixel centers inside it, row by row.
+        if (radius.x <= 0 || radius.y <= 0)
+        {
+            return;
+        }
+        double cx = fixed_to_double(center.x), cy = fixed_to_double(center.y);
+        double rx = fixed_to_double(radius.x), ry = fixed_to_double(radius.y);
+        int row_last = std::min(height_ - 1, fixed_floor(center.y + radius.y));
+        for (int y = std::max(0, fixed_ceil(center.y - radius.y)); y <= row_last; y++)
+        {
+            double vy = (y - cy) / ry;
+            double half = rx * std::sqrt(std::max(0.0, 1 - vy * vy));
+            int x0 = (int)std::ceil(cx - half);
+            int x1 = (int)std::floor(cx + half);
+            if (x0 <= x1)
+            {
+                fill_row(y, x0, x1, fill, alpha);
+            }
         }
     }
 
-    void PNGImage::draw_ellipse(const Point &center, const Point &radius, const Color &fill)
+    void PNGImage::draw_ellipse(const FixedPoint &center, const FixedPoint &radius, const Rotation &orientation,
+                                const Paint &fill, int alpha)
     {
-        draw_line(center.translate({-radius.x, 0}),
-                  center.translate({+radius.x, 0}),
-                  fill);
+        if (orientation.s == 0)
+        {
+            draw_ellipse(center, radius, fill, alpha);
+            return;
+        }
+        if (radius.x <= 0 || radius.y <= 0)
+        {
+            return;
+        }
+        double cx = fixed_to_double(center.x), cy = fixed_to_double(center.y);
+        double rx = fixed_to_double(radius.x), ry = fixed_to_double(radius.y);
+        double c = orientation.c, s = orientation.s;
+        // Points (cx + dx, cy + dy) inside satisfy A dx^2 + B dx dy + C dy^2 <= 1,
+        // where AC - B^2/4 = 1/(rx ry)^2. On row y this is a quadratic in dx,
+        // whose roots are mid +- half below.
+        double irx2 = 1 / (rx * rx), iry2 = 1 / (ry * ry);
+        double a = c * c * irx2 + s * s * iry2;
+        double b = 2 * c * s * (irx2 - iry2);
+        double det = irx2 * iry2;
+        double extent = std::sqrt(rx * rx * s * s + ry * ry * c * c);
+        if (antialiasing_)
+        {
+            if (alpha <= 0)
+            {
+                return;
+            }
+            // Box and coverage rows as in fill_antialiased. Each pixel row is
+            // sampled at ELLIPSE_SUBROWS rows, whose span on the conic is added
+            // with its exact horizontal coverage; nothing is flattened.
+            double extent_x = std::sqrt(rx * rx * c * c + ry * ry * s * s);
+            int box_x = std::max(0, (int)std::floor(cx - extent_x + 0.5));
+            int box_y = std::max(0, (int)std::floor(cy - extent + 0.5));
+            int box_w = std::min(width_, (int)std::ceil(cx + extent_x + 0.5)) - box_x;
+            int box_h = std::min(height_, (int)std::ceil(cy + extent + 0.5)) - box_y;
+            if (box_w <= 0 || box_h <= 0)
+            {
+                return;
+            }
+            size_t stride = box_w + 2;
+            coverage_.assign(stride * box_h, 0.0f);
+            for (int y = 0; y < box_h; y++)
+            {
+                float *acc = &coverage_[y * stride];
+                for (int k = 0; k < ELLIPSE_SUBROWS; k++)
+                {
+                    double dy = box_y + y - 0.5 + (k + 0.5) / ELLIPSE_SUBROWS - cy;
+                    double q = a - dy * dy * det;
+                    if (q <= 0)
+                    {
+                        continue;
+                    }
+                    double mid = cx - b * dy / (2 * a) + 0.5 - box_x;
+                    double half = std::sqrt(q) / a;
+                    accumulate_span(mid - half, mid + half, 1.0f / ELLIPSE_SUBROWS, acc, box_w);
+                }
+            }
+            blend_coverage(box_x, box_y, box_w, box_h, fill, alpha, FillRule::NonZero);
+            return;
+        }
+        int row_last = std::min(height_ - 1, (int)std::floor(cy + extent));
+        for (int y = std::max(0, (int)std::ceil(cy - extent)); y <= row_last; y++)
+        {
+            double dy = y - cy;
+            double q = a - dy * dy * det;
+            if (q < 0)
+            {
+                continue;
+            }
+            double mid = cx - b * dy / (2 * a);
+            double half = std::sqrt(q) / a;
+            int x0 = (int)std::ceil(mid - half);
+            int x1 = (int)std::floor(mid + half);
+            if (x0 <= x1)
+            {
+                fill_row(y, x0, x1, fill, alpha);
+            }
+        }
+    }
+
+    void PNGImage::fill_ellipse(const Point &center, const Point &radius, const Paint &fill, int alpha)
+    {
+        fill_row(center.y, center.x - radius.x, center.x + radius.x, fill, alpha);
         int x0 = radius.x;
         int dx = 0;
         for (int y = 1; y <= radius.y; y++)
@@ -199,12 +1012,364 @@ namespace svg
             }
             dx = x0 - x1;
             x0 = x1;
-            draw_line(center.translate({-x0, -y}),
-                      center.translate({+x0, -y}),
-                      fill);
-            draw_line(center.translate({-x0, +y}),
-                      center.translate({+x0, +y}),
-                      fill);
+            fill_row(center.y - y, center.x - x0, center.x + x0, fill, alpha);
+            fill_row(center.y + y, center.x - x0, center.x + x0, fill, alpha);
+        }
+    }
+
+    PixelRect PNGImage::pixel_rect(const BoundingBox &bounds) const
+    {
+        if (bounds.is_empty())
+        {
+            return {0, 0, 0, 0};
+        }
+        BoundingBox box = bounds.expand(FIXED_ONE);
+        int x0 = std::max(0, fixed_floor(box.x0)), x1 = std::min(width_ - 1, fixed_ceil(box.x1));
+        int y0 = std::max(0, fixed_floor(box.y0)), y1 = std::min(height_ - 1, fixed_ceil(box.y1));
+        if (x0 > x1 || y0 > y1)
+        {
+            return {0, 0, 0, 0};
+        }
+        return {x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+    }
+
+    void PNGImage::push_backdrop(const PixelRect &rect)
+    {
+        if (backdrop_count_ == backdrops_.size())
+        {
+            backdrops_.emplace_back();
+        }
+        std::vector<Color> &out = backdrops_[backdrop_count_++];
+        out.resize((size_t)rect.width * rect.height);
+        for (int y = 0; y < rect.height; y++)
+        {
+            const Color *src = row(rect.y + y) + rect.x;
+            std::copy(src, src + rect.width, out.begin() + (size_t)y * rect.width);
+        }
+    }
+
+    void PNGImage::pop_backdrop(const PixelRect &rect, int alpha)
+    {
+        assert(backdrop_count_ > 0);
+        const std::vector<Color> &backdrop = backdrops_[--backdrop_count_];
+        assert(backdrop.size() == (size_t)rect.width * rect.height);
+        for (int y = 0; y < rect.height; y++)
+        {
+            Color *dst = row(rect.y + y) + rect.x;
+            blend_pixels(dst, dst, backdrop.data() + (size_t)y * rect.width, rect.width, alpha);
+        }
+    }
+
+    void PNGImage::fill_contours(const std::vector<Contour> &contours, const Paint &fill, int alpha, FillRule rule)
+    {
+        if (antialiasing_)
+        {
+            fill_antialiased(contours, fill, alpha, rule);
+            return;
+        }
+        if (alpha <= 0)
+        {
+            return;
+        }
+        // Edge table, sorted by first row. Rows whose center y satisfies
+        // y0 <= y < y1 cross an edge; crossings are then stepped row by row in
+        // EDGE_SHIFT fixed-point.
+        edges_.clear();
+        for (const Contour &contour : contours)
+        {
+            for (size_t i = 0; i < contour.size(); i++)
+            {
+                Vertex a = contour[i];
+                Vertex b = contour[(i + 1) % contour.size()];
+                int dir = 1;
+                if (a.y > b.y)
+                {
+                    std::swap(a, b);
+                    dir = -1;
+                }
+                int row0 = (int)std::ceil(a.y), row1 = (int)std::ceil(b.y);
+                if (row0 >= row1)
+                {
+                    continue;
+                }
+                double slope = (b.x - a.x) / (b.y - a.y);
+                double x = a.x + (row0 - a.y) * slope;
+                int64_t step = row1 - row0 > 1 ? (int64_t)std::llround(std::ldexp(slope, EDGE_SHIFT)) : 0;
+                edges_.push_back({row0, row1, (int64_t)std::llround(std::ldexp(x, EDGE_SHIFT)), step, dir});
+            }
+        }
+        if (edges_.empty())
+        {
+            return;
+        }
+        std::sort(edges_.begin(), edges_.end(), [](const Edge &a, const Edge &b)
+                  { return a.row0 < b.row0; });
+        int row_max = edges_[0].row1;
+        for (const Edge &e : edges_)
+        {
+            row_max = std::max(row_max, e.row1);
+        }
+
+        const int64_t one = (int64_t)1 << EDGE_SHIFT;
+        int row_begin = std::max(0, edges_[0].row0);
+        int row_end = std::min(height_, row_max);
+        size_t next_edge = 0;
+        std::vector<Edge> &active = active_edges_;
+        active.clear();
+        for (int y = row_begin; y < row_end; y++)
+        {
+            while (next_edge < edges_.size() && edges_[next_edge].row0 <= y)
+            {
+                Edge e = edges_[next_edge++];
+                // Edges starting above the image are advanced to the first row.
+                e.x += (y - e.row0) * e.step;
+                active.push_back(e);
+            }
+            crossings_.clear();
+            size_t n = 0;
+            for (size_t i = 0; i < active.size(); i++)
+            {
+                Edge &e = active[i];
+                if (e.row1 <= y)
+                {
+                    continue;
+                }
+                // Snap to 1/65536 pixel so that the stepping error cannot move a
+                // crossing off a pixel center it hits exactly.
+                int64_t x = (e.x + (one >> 17)) & ~((one >> 16) - 1);
+                crossings_.push_back({x, e.dir});
+                e.x += e.step;
+                active[n++] = e;
+            }
+            active.resize(n);
+            std::sort(crossings_.begin(), crossings_.end());
+            // Pixels whose center x satisfies x_in <= x < x_out are inside.
+            int winding = 0;
+            for (size_t i = 0; i + 1 < crossings_.size(); i++)
+            {
+                winding += crossings_[i].second;
+                bool inside = rule == FillRule::NonZero ? winding != 0 : (winding & 1) != 0;
+                if (!inside)
+                {
+                    continue;
+                }
+                // Extend the span over following crossings that keep it inside.
+                int64_t x_in = crossings_[i].first;
+                while (i + 1 < crossings_.size())
+                {
+                    int w = winding + crossings_[i + 1].second;
+                    bool still_inside = rule == FillRule::NonZero ? w != 0 : (w & 1) != 0;
+                    if (!still_inside)
+                    {
+                        break;
+                    }
+                    winding = w;
+                    i++;
+                }
+                int64_t x_out = crossings_[i + 1].first;
+                int x0 = (int)std::max<int64_t>(0, (x_in + one - 1) >> EDGE_SHIFT);
+                int x1 = (int)std::min<int64_t>(width_, (x_out + one - 1) >> EDGE_SHIFT) - 1;
+                if (x0 <= x1)
+                {
+                    fill_row(y, x0, x1, fill, alpha);
+                }
+            }
+        }
+    }
+
+    Contour &PNGImage::single_contour()
+    {
+        contours_.resize(1);
+        contours_[0].clear();
+        return contours_[0];
+    }
+
+    void PNGImage::fill_antialiased(const std::vector<Contour> &contours, const Paint &c, int alpha, FillRule rule)
+    {
+        if (alpha <= 0)
+        {
+            return;
+        }
+        // Work in coordinates where pixel (x, y) covers [x, x+1] x [y, y+1].
+        double x_min = 0, x_max = -1, y_min = 0, y_max = -1;
+        for (const Contour &contour : contours)
+        {
+            for (const Vertex &v : contour)
+            {
+                if (x_min > x_max)
+                {
+                    x_min = x_max = v.x;
+                    y_min = y_max = v.y;
+                }
+                x_min = std::min(x_min, v.x);
+                x_max = std::max(x_max, v.x);
+                y_min = std::min(y_min, v.y);
+                y_max = std::max(y_max, v.y);
+            }
+        }
+        if (x_min > x_max)
+        {
+            return;
+        }
+        int box_x = std::max(0, (int)std::floor(x_min + 0.5));
+        int box_y = std::max(0, (int)std::floor(y_min + 0.5));
+        int box_w = std::min(width_, (int)std::ceil(x_max + 0.5)) - box_x;
+        int box_h = std::min(height_, (int)std::ceil(y_max + 0.5)) - box_y;
+        if (box_w <= 0 || box_h <= 0)
+        {
+            return;
+        }
+
+        // Each row holds box_w + 2 accumulators; the running sum of a row gives
+        // the signed coverage of each pixel.
+        size_t stride = box_w + 2;
+        coverage_.assign(stride * box_h, 0.0f);
+        for (const Contour &contour : contours)
+        {
+            for (size_t i = 0; i < contour.size(); i++)
+            {
+                const Vertex &a = contour[i];
+                const Vertex &b = contour[(i + 1) % contour.size()];
+                accumulate_segment({a.x + 0.5 - box_x, a.y + 0.5 - box_y},
+                                   {b.x + 0.5 - box_x, b.y + 0.5 - box_y},
+                                   box_w, box_h);
+            }
+        }
+
+        blend_coverage(box_x, box_y, box_w, box_h, c, alpha, rule);
+    }
+
+    void PNGImage::blend_coverage(int box_x, int box_y, int box_w, int box_h, const Paint &c, int alpha, FillRule rule)
+    {
+        size_t stride = box_w + 2;
+        float scale = alpha * (1.0f / 255.0f);
+        for (int y = 0; y < box_h; y++)
+        {
+            const float *acc = &coverage_[y * stride];
+            Color *pixels = row(y + box_y) + box_x;
+            float sum = 0;
+            int x = 0;
+            while (x < box_w)
+            {
+                sum += acc[x];
+                float cov = std::fabs(sum);
+                if (rule == FillRule::EvenOdd)
+                {
+                    cov = std::fmod(cov, 2.0f);
+                    cov = cov > 1.0f ? 2.0f - cov : cov;
+                }
+                if (cov >= 0.998f)
+                {
+                    // Interior span: no accumulator changes until the next edge.
+                    int end = x + 1;
+                    while (end < box_w && acc[end] == 0.0f)
+                    {
+                        end++;
+                    }
+                    paint_span(y + box_y, x + box_x, end - x, c, alpha);
+                    x = end;
+                    continue;
+                }
+                int a = (int)(cov * scale * 255 + 0.5f);
+                if (a > 0 && c.gradient)
+                {
+                    c.gradient->shade_span(pixels + x, x + box_x, y + box_y, 1, a);
+                }
+                else if (a > 0)
+                {
+                    blend_pixel(pixels[x], c.color, a);
+                }
+                x++;
+            }
+        }
+    }
+
+    void PNGImage::accumulate_segment(Vertex a, Vertex b, int box_w, int box_h)
+    {
+        if (a.y == b.y)
+        {
+            return;
+        }
+        // Split at the left and right box borders. Parts outside the box are
+        // projected onto the border, which preserves the winding of the pixels
+        // inside.
+        const double borders[2] = {0.0, (double)box_w};
+        for (double bx : borders)
+        {
+            if ((a.x < bx && b.x > bx) || (a.x > bx && b.x < bx))
+            {
+                double t = (bx - a.x) / (b.x - a.x);
+                Vertex m = {bx, a.y + t * (b.y - a.y)};
+                accumulate_segment(a, m, box_w, box_h);
+                accumulate_segment(m, b, box_w, box_h);
+                return;
+            }
+        }
+        a.x = std::min(std::max(a.x, 0.0), (double)box_w);
+        b.x = std::min(std::max(b.x, 0.0), (double)box_w);
+
+        double dir = 1.0;
+        if (a.y > b.y)
+        {
+            std::swap(a, b);
+            dir = -1.0;
+        }
+        double dxdy = (b.x - a.x) / (b.y - a.y);
+        double x = a.x;
+        int y0 = (int)std::floor(a.y);
+        if (y0 < 0)
+        {
+            x = std::min(std::max(x - a.y * dxdy, 0.0), (double)box_w);
+            y0 = 0;
+        }
+        int y1 = std::min(box_h, (int)std::ceil(b.y));
+        size_t stride = box_w + 2;
+        for (int y = y0; y < y1; y++)
+        {
+            float *acc = &coverage_[y * stride];
+            double dy = std::min((double)(y + 1), b.y) - std::max((double)y, a.y);
+            // Rounding can move x slightly past the box borders the segment
+            // was clipped to.
+            double x_next = std::min(std::max(x + dxdy * dy, 0.0), (double)box_w);
+            double d = dy * dir;
+            double x0 = std::min(x, x_next), x1 = std::max(x, x_next);
+            double x0_floor = std::floor(x0);
+            int x0i = (int)x0_floor;
+            double x1_ceil = std::ceil(x1);
+            int x1i = (int)x1_ceil;
+            if (x1i <= x0i + 1)
+            {
+                // The segment stays within one pixel column on this row.
+                double xm = 0.5 * (x + x_next) - x0_floor;
+                acc[x0i] += (float)(d - d * xm);
+                acc[x0i + 1] += (float)(d * xm);
+            }
+            else
+            {
+                double s = 1.0 / (x1 - x0);
+                double x0f = x0 - x0_floor;
+                double a0 = 0.5 * s * (1.0 - x0f) * (1.0 - x0f);
+                double x1f = x1 - x1_ceil + 1.0;
+                double am = 0.5 * s * x1f * x1f;
+                acc[x0i] += (float)(d * a0);
+                if (x1i == x0i + 2)
+                {
+                    acc[x0i + 1] += (float)(d * (1.0 - a0 - am));
+                }
+                else
+                {
+                    double a1 = s * (1.5 - x0f);
+                    acc[x0i + 1] += (float)(d * (a1 - a0));
+                    for (int xi = x0i + 2; xi < x1i - 1; xi++)
+                    {
+                        acc[xi] += (float)(d * s);
+                    }
+                    double a2 = a1 + (x1i - x0i - 3) * s;
+                    acc[x1i - 1] += (float)(d * (1.0 - a2 - am));
+                }
+                acc[x1i] += (float)(d * am);
+            }
+            x = x_next;
         }
     }
 
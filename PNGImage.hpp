@@ -3,13 +3,94 @@
 #define __svg_png_image_hpp__
 
 #include "Color.hpp"
+#include "Gradient.hpp"
 #include "Point.hpp"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace svg
 {
+    //! Closed sequence of vertices.
+    typedef std::vector<Vertex> Contour;
+
+    //! Writes contours over the ones already in a vector, reusing their
+    //! storage, so that a vector kept from shape to shape stops allocating.
+    //! The contours left over from earlier shapes are emptied when the
+    //! writer is destroyed; the fill functions skip empty contours.
+    class ContourWriter
+    {
+    public:
+        //! @param contours Output contours, replaced.
+        explicit ContourWriter(std::vector<Contour> &contours) : contours_(contours), count_(0) {}
+        ~ContourWriter()
+        {
+            for (size_t i = count_; i < contours_.size(); i++)
+            {
+                contours_[i].clear();
+            }
+        }
+        //! Start a contour.
+        //! @return The contour, empty.
+        Contour &add()
+        {
+            if (count_ == contours_.size())
+            {
+                contours_.emplace_back();
+            }
+            Contour &contour = contours_[count_++];
+            contour.clear();
+            return contour;
+        }
+        //! Drop the contour started last.
+        void drop_last() { contours_[--count_].clear(); }
+        //! @return The contour started last.
+        Contour &last() { return contours_[count_ - 1]; }
+
+    private:
+        std::vector<Contour> &contours_;
+        //! Number of contours written.
+        size_t count_;
+    };
+
+    //! Rule deciding which points are inside a set of contours.
+    enum class FillRule
+    {
+        //! Inside if the winding number is not zero.
+        NonZero,
+        //! Inside if the winding number is odd.
+        EvenOdd
+    };
+
+    //! Where the pixels of a blank image are kept.
+    enum class PixelStorage
+    {
+        //! Heap memory.
+        Memory,
+        //! A memory-mapped temporary file (in $TMPDIR or /tmp), so that images
+        //! larger than the physical memory are paged to that file instead of swap.
+        File
+    };
+
+    //! Pixel format of a saved PNG file.
+    enum class PixelFormat
+    {
+        //! 8-bit RGB.
+        RGB,
+        //! 8-bit grayscale (luma of the RGB pixels, BT.601 weights).
+        Gray
+    };
+
+    //! Rectangle of pixels.
+    struct PixelRect
+    {
+        //! Top-left pixel.
+        int x, y;
+        //! Size (0 for an empty rectangle).
+        int width, height;
+    };
+
     //! PNG image.
     class PNGImage
     {
@@ -21,7 +102,8 @@ namespace svg
         //! Initally, all pixels will be white.
         //! @param w Image width.
         //! @param h Image height.
-        PNGImage(int w, int h);
+        //! @param storage Pixel storage.
+        PNGImage(int w, int h, PixelStorage storage = PixelStorage::Memory);
         //! Destructor.
         ~PNGImage();
         //! Get image width.
@@ -40,32 +122,237 @@ namespace svg
         //! @param y Y position.
         //! @return Reference to pixel.
         Color at(int x, int y) const;
-        //! Save to output file.
+        //! Get the pixel storage.
+        //! @return Memory for loaded images.
+        PixelStorage storage() const;
+        //! Resize the image and make all its pixels white, as a new blank image
+        //! with the same storage would be. The pixel memory is only reallocated
+        //! if the image has more pixels than ever before, and the scratch
+        //! buffers of the drawing functions are kept, so an image can be reused
+        //! for many drawings without allocating.
+        //! @param w Image width.
+        //! @param h Image height.
+        void reset(int w, int h);
+        //! Buffer for the points of the shape being drawn, kept with the image
+        //! so that shapes can pass their points to the drawing functions
+        //! without allocating. The drawing functions do not use it themselves.
+        //! @return The buffer.
+        std::vector<FixedPoint> &point_buffer() { return point_buffer_; }
+        //! Buffer for the contours of the shape being drawn (e.g. written by
+        //! flatten_path through a ContourWriter), like point_buffer.
+        //! @return The buffer.
+        std::vector<Contour> &contour_buffer() { return contour_buffer_; }
+        //! Buffer for the polygons of a batch being drawn, like point_buffer.
+        //! @return The buffer.
+        std::vector<std::vector<FixedPoint>> &polygon_buffer() { return polygon_buffer_; }
+        //! Save to output file. File-backed images, and images too large for
+        //! the in-memory encoder, are streamed row by row without compression.
+        //! Throws std::runtime_error if the file cannot be written.
         //! @param png_file_name Output file name.
-        void save(const std::string &png_file_name) const;
+        //! @param format Pixel format of the file.
+        void save(const std::string &png_file_name, PixelFormat format = PixelFormat::RGB) const;
         //! Draw a line defined by 2 points.
         //! @param a First point.
         //! @param b Second point.
         //! @param c Color to use for the line.
-        void draw_line(const Point &a, const Point &b, const Color &c);
-        //! Draw a polygon.
+        //! @param alpha Opacity in [0, 255] (255 is opaque).
+        void draw_line(const FixedPoint &a, const FixedPoint &b, const Color &c, int alpha = 255);
+        //! Draw connected lines. With alpha < 255, pixels shared by
+        //! consecutive segments are blended only once.
+        //! @param points Vector of points defining the lines.
+        //! @param c Color to use for the lines.
+        //! @param alpha Opacity in [0, 255] (255 is opaque).
+        void draw_polyline(const std::vector<FixedPoint> &points, const Color &c, int alpha = 255);
+        //! Draw a polygon. Rows are sampled at pixel centers; the outline joins
+        //! the pixels nearest to the vertices.
+        //! @param points Vector of points defining the polygon.
+        //! @param fill Color or gradient to use for the polygon fill.
+        //! @param alpha Opacity in [0, 255] (255 is opaque).
+        void draw_polygon(const std::vector<FixedPoint> &points, const Paint &fill, int alpha = 255);
+        //! Draw opaque polygons of one color, with the same pixels as drawing
+        //! them in turn with draw_polygon: their spans are merged row by row
+        //! and each merged run is filled once.
+        //! @param polygons Vertices of each polygon.
+        //! @param c Color to use for the polygon fills.
+        void draw_polygons(const std::vector<std::vector<FixedPoint>> &polygons, const Color &c);
+        //! Draw a convex polygon (see is_convex), with the same pixels as draw_polygon.
+        //! Each row is filled between the crossings of the two chains joining
+        //! the top and bottom vertices, without scanning and sorting all edges.
         //! @param points Vector of points defining the polygon.
-        //! @param fill Color to use for the polygon fill.
-        void draw_polygon(const std::vector<Point> &points, const Color &fill);
-        //! Draw an ellipse.
+        //! @param fill Color or gradient to use for the polygon fill.
+        //! @param alpha Opacity in [0, 255] (255 is opaque).
+        void draw_convex_polygon(const std::vector<FixedPoint> &points, const Paint &fill, int alpha = 255);
+        //! Draw an ellipse. An ellipse with a fractional center or radius fills
+        //! the pixels whose centers lie inside it.
         //! @param center Coordinates for the ellipse center.
         //! @param radius Radius in X and Y axis.
-        //! @param fill Color to use for the ellipse fill.
-        //! @param orientation ellipse orientation.
-        void draw_ellipse(const Point &center, const Point &radius, const Color &fill);
+        //! @param fill Color or gradient to use for the ellipse fill.
+        //! @param alpha Opacity in [0, 255] (255 is opaque).
+        void draw_ellipse(const FixedPoint &center, const FixedPoint &radius, const Paint &fill, int alpha = 255);
+        //! Draw an ellipse whose X radius lies along the given orientation.
+        //! Each row is filled between the two crossings of the ellipse conic,
+        //! solved analytically, at pixel centers; without rotation, this is
+        //! the axis-aligned draw_ellipse.
+        //! @param center Coordinates for the ellipse center.
+        //! @param radius Radius along the rotated X and Y axis.
+        //! @param orientation Rotation of the X axis.
+        //! @param fill Color or gradient to use for the ellipse fill.
+        //! @param alpha Opacity in [0, 255] (255 is opaque).
+        void draw_ellipse(const FixedPoint &center, const FixedPoint &radius, const Rotation &orientation,
+                          const Paint &fill, int alpha = 255);
+        //! Fill a set of closed contours in a single scanline pass, so that
+        //! overlapping contours paint each pixel once. Pixels are sampled at their
+        //! centers (integer coordinates); with anti-aliasing, coverage is exact.
+        //! @param contours Contours.
+        //! @param fill Fill color or gradient.
+        //! @param alpha Opacity in [0, 255] (255 is opaque).
+        //! @param rule Fill rule.
+        void fill_contours(const std::vector<Contour> &contours, const Paint &fill, int alpha, FillRule rule);
+        //! Get the pixels that drawing within a box can change: the box, in
+        //! pixel centers, with one pixel of margin for outline rounding and
+        //! anti-aliased edges, clipped to the image.
+        //! @param bounds Box, e.g. the bounds of an element.
+        //! @return The rectangle (possibly empty).
+        PixelRect pixel_rect(const BoundingBox &bounds) const;
+        //! Save the pixels of a rectangle, e.g. the backdrop of a translucent
+        //! group, on a stack of copies kept with the image, so that nested
+        //! groups each save their own without allocating once it has grown.
+        //! @param rect Rectangle, within the image.
+        void push_backdrop(const PixelRect &rect);
+        //! Blend the current pixels of a rectangle over the copy saved last
+        //! by push_backdrop, and drop it: pixel = pixel * alpha + backdrop * (255 - alpha).
+        //! @param rect Rectangle of the copy.
+        //! @param alpha Opacity in [0, 255] of what was drawn since the copy.
+        void pop_backdrop(const PixelRect &rect, int alpha);
+        //! Enable or disable anti-aliasing.
+        //! When enabled, draw_line, draw_polygon and draw_ellipse compute the exact
+        //! area of each pixel covered by the shape (pixel (x, y) being the unit
+        //! square centered at (x, y)) and blend the color accordingly.
+        //! @param enabled True to enable anti-aliasing.
+        void set_antialiasing(bool enabled);
+        //! Check if anti-aliasing is enabled.
+        //! @return True if anti-aliasing is enabled.
+        bool antialiasing() const;
 
     private:
+        //! Horizontal run of pixels [x0, x1] on row y.
+        struct Span
+        {
+            int y;
+            int x0;
+            int x1;
+        };
+        //! Fractional bits of the x coordinates stepped along edges.
+        static const int EDGE_SHIFT = 32;
+        //! Contour edge crossing at least one row center, oriented top to bottom.
+        struct Edge
+        {
+            //! First row and one past the last row crossed.
+            int row0, row1;
+            //! X at the current row and dx/dy, with EDGE_SHIFT fractional bits.
+            int64_t x, step;
+            //! +1 if the contour goes down along this edge, -1 otherwise.
+            int dir;
+        };
+        //! Fill contours with anti-aliasing.
+        //! @param contours Contours.
+        //! @param c Fill paint.
+        //! @param alpha Opacity in [0, 255].
+        //! @param rule Fill rule.
+        void fill_antialiased(const std::vector<Contour> &contours, const Paint &c, int alpha,
+                              FillRule rule = FillRule::NonZero);
+        //! Make contours_ a single empty contour, to build a shape to fill
+        //! with fill_antialiased(contours_, ...).
+        //! @return The contour.
+        Contour &single_contour();
+        //! Draw an aliased ellipse with integer center and radius.
+        void fill_ellipse(const Point &center, const Point &radius, const Paint &fill, int alpha);
+        //! Append the spans covered by an aliased polygon (fill and outline) to spans_.
+        //! @param points Polygon vertices.
+        void polygon_spans(const std::vector<FixedPoint> &points);
+        //! Fill the spans in spans_. With alpha < 255, overlapping spans are merged first.
+        //! @param c Paint.
+        //! @param alpha Opacity in [0, 255].
+        void fill_spans(const Paint &c, int alpha);
+        //! Merge the overlapping and adjacent spans in spans_ and fill each
+        //! merged run once, so every pixel is painted once.
+        //! @param c Paint.
+        //! @param alpha Opacity in [0, 255].
+        void fill_merged_spans(const Paint &c, int alpha);
+        //! Fill pixels [x0, x1] of row y, clipped to the image.
+        void fill_row(int y, int x0, int x1, const Paint &c, int alpha);
+        //! Blend a paint over n pixels of row y starting at x, all in the image:
+        //! the color with blend_span, or the gradient's span shader.
+        void paint_span(int y, int x, size_t n, const Paint &c, int alpha);
+        //! Append span [x0, x1] of row y to spans_ if the row is in the image.
+        void add_span(int y, int x0, int x1);
+        //! First pixel of row y (indexed in 64 bits).
+        Color *row(int y) { return pixels_ + (size_t)y * width_; }
+        const Color *row(int y) const { return pixels_ + (size_t)y * width_; }
+        //! Replace the pixel memory by room for count pixels.
+        void allocate(size_t count, PixelStorage storage);
+        //! Count the pixel memory as an allocation, if allocations are being
+        //! counted (see Alloc.hpp).
+        void count_pixels();
+        //! Free the pixel memory.
+        void release();
+        //! Write the image as a PNG with stored (uncompressed) deflate blocks,
+        //! reading the rows in order.
+        //! @param png_file_name Output file name.
+        //! @param format Pixel format of the file.
+        void save_uncompressed(const std::string &png_file_name, PixelFormat format) const;
+        //! Check if a pixel is in the image.
+        bool contains(int x, int y) const
+        {
+            return x >= 0 && x < width_ && y >= 0 && y < height_;
+        }
+        //! Accumulate the signed area contribution of a segment into coverage_.
+        //! Coordinates are relative to the accumulation box.
+        void accumulate_segment(Vertex a, Vertex b, int box_w, int box_h);
+        //! Blend a paint over the pixels of a box with the coverage in coverage_,
+        //! box_w + 2 running-sum accumulators per row (see fill_antialiased).
+        //! @param box_x Left pixel of the box.
+        //! @param box_y Top pixel of the box.
+        //! @param box_w Box width, within the image.
+        //! @param box_h Box height, within the image.
+        //! @param c Paint.
+        //! @param alpha Opacity in [0, 255].
+        //! @param rule Fill rule applied to the winding coverage.
+        void blend_coverage(int box_x, int box_y, int box_w, int box_h, const Paint &c, int alpha, FillRule rule);
+
         //! Width.
         int width_;
         //! Height.
         int height_;
         //! Pixels.
         Color *pixels_;
+        //! Number of pixels the pixel memory can hold.
+        size_t capacity_;
+        //! Size of the file mapping holding the pixels, 0 for heap memory.
+        size_t mapped_bytes_;
+        //! Counting run the pixel memory was counted in (see alloc::on_alloc), 0 if none.
+        uint32_t counted_run_;
+        //! Anti-aliasing flag.
+        bool antialiasing_;
+        //! Coverage accumulation buffer for anti-aliased fills (reused between calls).
+        std::vector<float> coverage_;
+        //! Span buffers for aliased fills (reused between calls).
+        std::vector<Span> spans_, sorted_spans_;
+        //! Per-row offsets into sorted_spans_.
+        std::vector<size_t> row_starts_;
+        //! Scratch contours and edges (reused between calls).
+        std::vector<Contour> contours_;
+        std::vector<Edge> edges_, active_edges_;
+        std::vector<std::pair<int64_t, int>> crossings_;
+        //! Crossings of one row by a polygon (reused between calls).
+        std::vector<int> row_crossings_;
+        //! See point_buffer, contour_buffer and polygon_buffer.
+        std::vector<FixedPoint> point_buffer_;
+        std::vector<Contour> contour_buffer_;
+        std::vector<std::vector<FixedPoint>> polygon_buffer_;
+        //! Backdrops saved by push_backdrop; the first backdrop_count_ are in use.
+        std::vector<std::vector<Color>> backdrops_;
+        size_t backdrop_count_;
     };
 }
 
@@ -0,0 +1,373 @@
+#include "Path.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace svg
+{
+    namespace
+    {
+        //! Largest number of segments evaluated by forward differencing; larger
+        //! curves are split first, so that rounding errors do not accumulate.
+        const int MAX_STEPS = 256;
+
+        bool is_space(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f'; }
+        bool is_digit(char c) { return c >= '0' && c <= '9'; }
+        bool is_command(char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'); }
+
+        void skip_spaces(const char *&s)
+        {
+            while (is_space(*s))
+                s++;
+        }
+
+        //! Skip whitespace and at most one comma.
+        void skip_separator(const char *&s)
+        {
+            skip_spaces(s);
+            if (*s == ',')
+            {
+                s++;
+                skip_spaces(s);
+            }
+        }
+
+        //! Read a number ([sign] digits [. digits] [exponent]) without allocating.
+        bool read_number(const char *&s, double &v)
+        {
+            const char *p = s;
+            bool negative = *p == '-';
+            if (*p == '+' || *p == '-')
+                p++;
+            double m = 0;
+            bool digits = false;
+            for (; is_digit(*p); p++, digits = true)
+                m = m * 10 + (*p - '0');
+            if (*p == '.')
+            {
+                double f = 0.1;
+                for (p++; is_digit(*p); p++, f *= 0.1, digits = true)
+                    m += (*p - '0') * f;
+            }
+            if (!digits)
+                return false;
+            if (*p == 'e' || *p == 'E')
+            {
+                const char *q = p + 1;
+                bool negative_exp = *q == '-';
+                if (*q == '+' || *q == '-')
+                    q++;
+                if (is_digit(*q))
+                {
+                    int e = 0;
+                    for (; is_digit(*q); q++)
+                        e = std::min(e * 10 + (*q - '0'), 1000);
+                    m *= std::pow(10.0, negative_exp ? -e : e);
+                    p = q;
+                }
+            }
+            v = negative ? -m : m;
+            s = p;
+            return true;
+        }
+
+        //! Number of arguments of a command, -1 if unsupported.
+        int argument_count(char command)
+        {
+            switch (command)
+            {
+            case 'M': case 'L': case 'T': return 2;
+            case 'H': case 'V': return 1;
+            case 'S': case 'Q': return 4;
+            case 'C': return 6;
+            case 'Z': return 0;
+            default: return -1;
+            }
+        }
+
+        Vertex midpoint(const Vertex &a, const Vertex &b) { return {(a.x + b.x) / 2, (a.y + b.y) / 2}; }
+
+        //! Append a quadratic curve from p0 (excluded) to p2. p0 is taken by
+        //! value, since it is usually the last vertex of out.
+        void flatten_quad(Vertex p0, const Vertex &p1, const Vertex &p2, double tolerance, Contour &out)
+        {
+            // B(t) = a t^2 + b t + p0.
+            double ax = p0.x - 2 * p1.x + p2.x, ay = p0.y - 2 * p1.y + p2.y;
+            // Wang's formula: n = sqrt(d (d - 1) / 8 * M / tolerance) for degree d.
+            double steps = std::ceil(std::sqrt(std::hypot(ax, ay) / (4 * tolerance)));
+            if (steps > MAX_STEPS)
+            {
+                Vertex q0 = midpoint(p0, p1), q1 = midpoint(p1, p2), m = midpoint(q0, q1);
+                flatten_quad(p0, q0, m, tolerance, out);
+                flatten_quad(m, q1, p2, tolerance, out);
+                return;
+            }
+            int n = std::max(1, (int)steps);
+            double h = 1.0 / n;
+            double bx = 2 * (p1.x - p0.x), by = 2 * (p1.y - p0.y);
+            double x = p0.x, y = p0.y;
+            double dx = ax * h * h + bx * h, dy = ay * h * h + by * h;
+            double ddx = 2 * ax * h * h, ddy = 2 * ay * h * h;
+            for (int i = 1; i < n; i++)
+            {
+                x += dx;
+                y += dy;
+                dx += ddx;
+                dy += ddy;
+                out.push_back({x, y});
+            }
+            out.push_back(p2);
+        }
+
+        //! Append a cubic curve from p0 (excluded) to p3, p0 by value as for
+        //! flatten_quad.
+        void flatten_cubic(Vertex p0, const Vertex &p1, const Vertex &p2, const Vertex &p3,
+                           double tolerance, Contour &out)
+        {
+            double m = std::max(std::hypot(p0.x - 2 * p1.x + p2.x, p0.y - 2 * p1.y + p2.y),
+                                std::hypot(p1.x - 2 * p2.x + p3.x, p1.y - 2 * p2.y + p3.y));
+            double steps = std::ceil(std::sqrt(0.75 * m / tolerance));
+            if (steps > MAX_STEPS)
+            {
+                Vertex q0 = midpoint(p0, p1), q1 = midpoint(p1, p2), q2 = midpoint(p2, p3);
+                Vertex r0 = midpoint(q0, q1), r1 = midpoint(q1, q2), s = midpoint(r0, r1);
+                flatten_cubic(p0, q0, r0, s, tolerance, out);
+                flatten_cubic(s, r1, q2, p3, tolerance, out);
+                return;
+            }
+            int n = std::max(1, (int)steps);
+            double h = 1.0 / n, h2 = h * h, h3 = h2 * h;
+            // B(t) = a t^3 + b t^2 + c t + p0.
+            double ax = 3 * (p1.x - p2.x) + p3.x - p0.x, ay = 3 * (p1.y - p2.y) + p3.y - p0.y;
+            double bx = 3 * (p0.x - 2 * p1.x + p2.x), by = 3 * (p0.y - 2 * p1.y + p2.y);
+            double cx = 3 * (p1.x - p0.x), cy = 3 * (p1.y - p0.y);
+            double x = p0.x, y = p0.y;
+            double dx = ax * h3 + bx * h2 + cx * h, dy = ay * h3 + by * h2 + cy * h;
+            double ddx = 6 * ax * h3 + 2 * bx * h2, ddy = 6 * ay * h3 + 2 * by * h2;
+            double dddx = 6 * ax * h3, dddy = 6 * ay * h3;
+            for (int i = 1; i < n; i++)
+            {
+                x += dx;
+                y += dy;
+                dx += ddx;
+                dy += ddy;
+                ddx += dddx;
+                ddy += dddy;
+                out.push_back({x, y});
+            }
+            out.push_back(p3);
+        }
+    }
+
+    bool parse_path_data(const char *d, std::vector<PathVerb> &verbs, std::vector<FixedPoint> &points)
+    {
+        if (d == nullptr)
+            return true;
+        // Current point, start of the current subpath and last control point, unrounded.
+        double cx = 0, cy = 0, sx = 0, sy = 0, px = 0, py = 0;
+        char command = 0, previous = 0;
+        // Whether the current subpath has its MoveTo (a segment after Z starts a new one).
+        bool open = false;
+        auto add = [&](PathVerb verb, double x, double y)
+        {
+            verbs.push_back(verb);
+            points.push_back({to_fixed(x), to_fixed(y)});
+        };
+        auto add_point = [&](double x, double y) { points.push_back({to_fixed(x), to_fixed(y)}); };
+
+        const char *s = d;
+        skip_spaces(s);
+        while (*s != '\0')
+        {
+            if (is_command(*s))
+            {
+                command = *s++;
+                skip_spaces(s);
+            }
+            else if (command == 0 || command == 'Z' || command == 'z')
+            {
+                // Numbers without a command.
+                return false;
+            }
+            else if (command == 'M' || command == 'm')
+            {
+                // Coordinates after a MoveTo are implicit LineTos.
+                command = command == 'M' ? 'L' : 'l';
+            }
+            bool relative = command >= 'a';
+            char upper = relative ? command - 'a' + 'A' : command;
+            int count = argument_count(upper);
+            // Path data starts with a MoveTo.
+            if (count < 0 || (previous == 0 && upper != 'M'))
+                return false;
+            double a[6];
+            for (int i = 0; i < count; i++)
+            {
+                if (i > 0)
+                    skip_separator(s);
+                if (!read_number(s, a[i]))
+                    return false;
+            }
+            double ox = relative ? cx : 0, oy = relative ? cy : 0;
+            if (upper != 'M' && upper != 'Z' && !open)
+            {
+                add(PathVerb::MoveTo, cx, cy);
+                open = true;
+            }
+            switch (upper)
+            {
+            case 'M':
+                cx = sx = ox + a[0];
+                cy = sy = oy + a[1];
+                add(PathVerb::MoveTo, cx, cy);
+                open = true;
+                break;
+            case 'L':
+                cx = ox + a[0];
+                cy = oy + a[1];
+                add(PathVerb::LineTo, cx, cy);
+                break;
+            case 'H':
+                cx = ox + a[0];
+                add(PathVerb::LineTo, cx, cy);
+                break;
+            case 'V':
+                cy = oy + a[0];
+                add(PathVerb::LineTo, cx, cy);
+                break;
+            case 'C':
+            case 'S':
+            {
+                double x1, y1;
+                if (upper == 'C')
+                {
+                    x1 = ox + a[0];
+                    y1 = oy + a[1];
+                }
+                else
+                {
+                    // First control point reflected from the previous cubic.
+                    bool smooth = previous == 'C' || previous == 'S';
+                    x1 = smooth ? 2 * cx - px : cx;
+                    y1 = smooth ? 2 * cy - py : cy;
+                }
+                const double *rest = upper == 'C' ? a + 2 : a;
+                px = ox + rest[0];
+                py = oy + rest[1];
+                verbs.push_back(PathVerb::CubicTo);
+                add_point(x1, y1);
+                add_point(px, py);
+                cx = ox + rest[2];
+                cy = oy + rest[3];
+                add_point(cx, cy);
+                break;
+            }
+            case 'Q':
+            case 'T':
+                if (upper == 'Q')
+                {
+                    px = ox + a[0];
+                    py = oy + a[1];
+                }
+                else
+                {
+                    // Control point reflected from the previous quadratic.
+                    bool smooth = previous == 'Q' || previous == 'T';
+                    px = smooth ? 2 * cx - px : cx;
+                    py = smooth ? 2 * cy - py : cy;
+                }
+                verbs.push_back(PathVerb::QuadTo);
+                add_point(px, py);
+                cx = ox + a[count - 2];
+                cy = oy + a[count - 1];
+                add_point(cx, cy);
+                break;
+            case 'Z':
+                verbs.push_back(PathVerb::Close);
+                cx = sx;
+                cy = sy;
+                open = false;
+                break;
+            }
+            previous = upper;
+            skip_separator(s);
+        }
+        return true;
+    }
+
+    FillRule parse_fill_rule(const char *str)
+    {
+        if (str != nullptr && std::strcmp(str, "evenodd") == 0)
+            return FillRule::EvenOdd;
+        return FillRule::NonZero;
+    }
+
+    void flatten_path(const std::vector<PathVerb> &verbs, const std::vector<FixedPoint> &points,
+                      double tolerance, std::vector<Contour> &contours)
+    {
+        ContourWriter out(contours);
+        // Contour of the current subpath, started by its first point.
+        Contour *contour = nullptr;
+        auto current = [&]() -> Contour &
+        {
+            if (contour == nullptr)
+                contour = &out.add();
+            return *contour;
+        };
+        // Subpaths are closed for filling; those without area are dropped.
+        auto finish = [&]()
+        {
+            if (contour != nullptr && contour->size() < 3)
+                out.drop_last();
+            contour = nullptr;
+        };
+        size_t i = 0;
+        for (PathVerb verb : verbs)
+        {
+            switch (verb)
+            {
+            case PathVerb::MoveTo:
+                finish();
+                current().push_back(points[i++].vertex());
+                break;
+            case PathVerb::LineTo:
+                current().push_back(points[i++].vertex());
+                break;
+            case PathVerb::QuadTo:
+                flatten_quad(current().back(), points[i].vertex(), points[i + 1].vertex(), tolerance, current());
+                i += 2;
+                break;
+            case PathVerb::CubicTo:
+                flatten_cubic(current().back(), points[i].vertex(), points[i + 1].vertex(), points[i + 2].vertex(),
+                              tolerance, current());
+                i += 3;
+                break;
+            case PathVerb::Close:
+                finish();
+                break;
+            }
+        }
+        finish();
+    }
+
+    bool contours_contain(const std::vector<Contour> &contours, const Vertex &p, FillRule rule)
+    {
+        int winding = 0;
+        for (const Contour &contour : contours)
+        {
+            for (size_t i = 0; i < contour.size(); i++)
+            {
+                const Vertex &a = contour[i];
+                const Vertex &b = contour[(i + 1) % contour.size()];
+                double cross = (b.x - a.x) * (p.y - a.y) - (p.x - a.x) * (b.y - a.y);
+                // Crossings of the horizontal ray to the right of p, half-open in y.
+                if (a.y <= p.y && b.y > p.y && cross > 0)
+                    winding++;
+                else if (b.y <= p.y && a.y > p.y && cross < 0)
+                    winding--;
+            }
+        }
+        return rule == FillRule::EvenOdd ? (winding & 1) != 0 : winding != 0;
+    }
+}
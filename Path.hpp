@@ -0,0 +1,60 @@
+//! @file Path.hpp
+#ifndef __svg_Path_hpp__
+#define __svg_Path_hpp__
+
+#include "PNGImage.hpp"
+#include "Point.hpp"
+
+#include <vector>
+
+namespace svg
+{
+    //! Path segment, in absolute coordinates. Each verb uses the next
+    //! 1 (MoveTo, LineTo), 2 (QuadTo) or 3 (CubicTo) points, the last one
+    //! being the new current point. Close uses no point.
+    enum class PathVerb : unsigned char
+    {
+        MoveTo,
+        LineTo,
+        QuadTo,
+        CubicTo,
+        Close
+    };
+
+    //! Maximum distance, in pixels, between a curve and its flattened outline.
+    const double PATH_TOLERANCE = 0.2;
+
+    //! Parse path data (the d attribute): M, L, H, V, C, S, Q, T and Z, absolute
+    //! and relative. Commands are reduced to absolute MoveTo, LineTo, QuadTo,
+    //! CubicTo and Close. Like other SVG renderers, parsing stops at the first
+    //! error (or unsupported command), keeping the segments before it.
+    //! @param d Path data (nullptr for an empty path).
+    //! @param verbs Output verbs (appended).
+    //! @param points Output points (appended).
+    //! @return True if the whole string was parsed.
+    bool parse_path_data(const char *d, std::vector<PathVerb> &verbs, std::vector<FixedPoint> &points);
+
+    //! Parse a fill-rule value ("nonzero" or "evenodd").
+    //! @param str Attribute value (nullptr for the default).
+    //! @return The fill rule, NonZero if unknown.
+    FillRule parse_fill_rule(const char *str);
+
+    //! Flatten a path into one closed contour per subpath, in pixels.
+    //! The number of segments of each curve is derived from its second
+    //! differences (Wang's formula), and the curve is then evaluated by
+    //! forward differencing; very large curves are split in halves first.
+    //! @param verbs Path verbs.
+    //! @param points Path points.
+    //! @param tolerance Maximum distance in pixels between a curve and its segments.
+    //! @param contours Output contours, replaced (their storage is reused, see ContourWriter).
+    void flatten_path(const std::vector<PathVerb> &verbs, const std::vector<FixedPoint> &points,
+                      double tolerance, std::vector<Contour> &contours);
+
+    //! Check if a point is inside a set of contours.
+    //! @param contours Closed contours.
+    //! @param p Point, in pixels.
+    //! @param rule Fill rule.
+    //! @return True if inside.
+    bool contours_contain(const std::vector<Contour> &contours, const Vertex &p, FillRule rule);
+}
+#endif
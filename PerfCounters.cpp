@@ -0,0 +1,106 @@
+#include "PerfCounters.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+// Linux headers
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace svg
+{
+    const char *PerfCounters::NAMES[NUM_COUNTERS] = {
+        "cycles", "instructions", "cache_references", "cache_misses", "branch_misses"};
+
+    namespace
+    {
+        const uint64_t EVENT_CONFIGS[PerfCounters::NUM_COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_REFERENCES,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES};
+
+        int open_counter(uint64_t config)
+        {
+            perf_event_attr attr;
+            ::memset(&attr, 0, sizeof(attr));
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            // Also count the threads started later, e.g. by readSVG.
+            attr.inherit = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            return (int)::syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+    }
+
+    PerfCounters::PerfCounters()
+    {
+        for (int c = 0; c < NUM_COUNTERS; c++)
+        {
+            fds_[c] = open_counter(EVENT_CONFIGS[c]);
+            if (fds_[c] < 0 && error_.empty())
+            {
+                error_ = std::string(NAMES[c]) + ": " + ::strerror(errno);
+                if (errno == EACCES || errno == EPERM)
+                {
+                    error_ += " (check /proc/sys/kernel/perf_event_paranoid)";
+                }
+            }
+        }
+    }
+
+    PerfCounters::~PerfCounters()
+    {
+        for (int fd : fds_)
+        {
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+    }
+
+    bool PerfCounters::available() const
+    {
+        for (int fd : fds_)
+        {
+            if (fd >= 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool PerfCounters::has(Counter c) const
+    {
+        return fds_[c] >= 0;
+    }
+
+    const std::string &PerfCounters::error() const
+    {
+        return error_;
+    }
+
+    void PerfCounters::read(uint64_t values[NUM_COUNTERS]) const
+    {
+        for (int c = 0; c < NUM_COUNTERS; c++)
+        {
+            values[c] = 0;
+            // value, time enabled, time running.
+            uint64_t data[3];
+            if (fds_[c] >= 0 && ::read(fds_[c], data, sizeof(data)) == (ssize_t)sizeof(data))
+            {
+                values[c] = data[2] > 0 && data[2] < data[1]
+                                ? (uint64_t)((double)data[0] * data[1] / data[2])
+                                : data[0];
+            }
+        }
+    }
+}
@@ -0,0 +1,60 @@
+//! @file PerfCounters.hpp
+#ifndef __svg_PerfCounters_hpp__
+#define __svg_PerfCounters_hpp__
+
+#include <cstdint>
+#include <string>
+
+namespace svg
+{
+    //! Hardware performance counters of the calling thread and of the threads
+    //! it starts afterwards, read through the Linux perf_event_open interface.
+    //! A thread's counts are added when it exits, so worker threads must be
+    //! joined before the end of the phase they belong to. Counters the kernel does not allow
+    //! (see /proc/sys/kernel/perf_event_paranoid) or the CPU does not provide
+    //! are simply reported as unavailable.
+    class PerfCounters
+    {
+    public:
+        //! Counted events.
+        enum Counter
+        {
+            CYCLES,
+            INSTRUCTIONS,
+            CACHE_REFERENCES,
+            CACHE_MISSES,
+            BRANCH_MISSES,
+            NUM_COUNTERS
+        };
+        //! Event names, indexed by Counter.
+        static const char *NAMES[NUM_COUNTERS];
+
+        //! Constructor. Opens and starts all counters (user space only).
+        PerfCounters();
+        //! Destructor.
+        ~PerfCounters();
+        //! Check if at least one counter could be opened.
+        //! @return True if counters are available.
+        bool available() const;
+        //! Check if a counter could be opened.
+        //! @param c Counter.
+        //! @return True if the counter is available.
+        bool has(Counter c) const;
+        //! Get the reason why counters are unavailable.
+        //! @return Error message (empty if all counters were opened).
+        const std::string &error() const;
+        //! Read the current counter values, scaled for multiplexing.
+        //! Unavailable counters read as 0.
+        //! @param values Output values, indexed by Counter.
+        void read(uint64_t values[NUM_COUNTERS]) const;
+
+    private:
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+        //! Counter file descriptors (-1 if unavailable).
+        int fds_[NUM_COUNTERS];
+        //! Error message.
+        std::string error_;
+    };
+}
+#endif
@@ -1,5 +1,6 @@
 //! @file point.cpp
 #include <cmath>
+#include <algorithm>
 #include "Point.hpp"
 
 namespace svg
@@ -27,4 +28,181 @@ namespace svg
                 origin.y + (y - origin.y) * v};
     }
 
+    Rotation Rotation::degrees(double degrees)
+    {
+        double angle = M_PI * degrees / 180.0;
+        return {::cos(angle), ::sin(angle)};
+    }
+
+    Affine Affine::identity()
+    {
+        return {1, 0, 0, 0, 1, 0};
+    }
+
+    Vertex Affine::apply(const Vertex &p) const
+    {
+        return {a * p.x + b * p.y + c, d * p.x + e * p.y + f};
+    }
+
+    Affine Affine::operator*(const Affine &o) const
+    {
+        return {a * o.a + b * o.d, a * o.b + b * o.e, a * o.c + b * o.f + c,
+                d * o.a + e * o.d, d * o.b + e * o.e, d * o.c + e * o.f + f};
+    }
+
+    Affine Affine::inverse() const
+    {
+        double det = a * e - b * d;
+        double ia = e / det, ib = -b / det, id = -d / det, ie = a / det;
+        return {ia, ib, -(ia * c + ib * f), id, ie, -(id * c + ie * f)};
+    }
+
+    FixedPoint FixedPoint::from(const Point &p)
+    {
+        return {to_fixed(p.x), to_fixed(p.y)};
+    }
+
+    FixedPoint FixedPoint::translate(const FixedPoint &t) const
+    {
+        return {x + t.x, y + t.y};
+    }
+
+    FixedPoint FixedPoint::rotate(const FixedPoint &origin, const Rotation &r) const
+    {
+        fixed_value ox = x - origin.x, oy = y - origin.y;
+        double dx = fixed_to_double(ox);
+        double dy = fixed_to_double(oy);
+        double rx = r.c * dx - r.s * dy;
+        double ry = r.s * dx + r.c * dy;
+        if (((ox | oy) & (FIXED_ONE - 1)) == 0)
+        {
+            // Whole-pixel offsets are rounded to whole pixels, as Point::rotate
+            // does, so that rotated integer geometry stays on the pixel grid.
+            return {origin.x + to_fixed((int)::lround(rx)), origin.y + to_fixed((int)::lround(ry))};
+        }
+        return {origin.x + to_fixed(rx), origin.y + to_fixed(ry)};
+    }
+
+    FixedPoint FixedPoint::scale(const FixedPoint &origin, double v) const
+    {
+        return {origin.x + (fixed_value)::lround((x - origin.x) * v),
+                origin.y + (fixed_value)::lround((y - origin.y) * v)};
+    }
+
+    Point FixedPoint::round() const
+    {
+        return {fixed_round(x), fixed_round(y)};
+    }
+
+    Vertex FixedPoint::vertex() const
+    {
+        return {fixed_to_double(x), fixed_to_double(y)};
+    }
+
+    BoundingBox BoundingBox::empty()
+    {
+        return {0, 0, -1, -1};
+    }
+
+    bool BoundingBox::is_empty() const
+    {
+        return x1 < x0 || y1 < y0;
+    }
+
+    void BoundingBox::add(const FixedPoint &p)
+    {
+        if (is_empty())
+        {
+            *this = {p.x, p.y, p.x, p.y};
+            return;
+        }
+        x0 = std::min(x0, p.x);
+        y0 = std::min(y0, p.y);
+        x1 = std::max(x1, p.x);
+        y1 = std::max(y1, p.y);
+    }
+
+    void BoundingBox::add(const BoundingBox &b)
+    {
+        if (b.is_empty())
+        {
+            return;
+        }
+        add(FixedPoint{b.x0, b.y0});
+        add(FixedPoint{b.x1, b.y1});
+    }
+
+    BoundingBox BoundingBox::expand(fixed_value d) const
+    {
+        if (is_empty())
+        {
+            return *this;
+        }
+        return {x0 - d, y0 - d, x1 + d, y1 + d};
+    }
+
+    bool BoundingBox::intersects(const BoundingBox &b) const
+    {
+        return !is_empty() && !b.is_empty() &&
+               x0 <= b.x1 && b.x0 <= x1 && y0 <= b.y1 && b.y0 <= y1;
+    }
+
+    bool is_convex(const std::vector<FixedPoint> &points)
+    {
+        // Repeated points would hide the turn between their neighbours.
+        std::vector<FixedPoint> v;
+        for (const FixedPoint &p : points)
+        {
+            if (v.empty() || p.x != v.back().x || p.y != v.back().y)
+            {
+                v.push_back(p);
+            }
+        }
+        while (v.size() > 1 && v.front().x == v.back().x && v.front().y == v.back().y)
+        {
+            v.pop_back();
+        }
+        size_t n = v.size();
+        int turn = 0, first_dir = 0, last_dir = 0, dir_changes = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            const FixedPoint &a = v[i];
+            const FixedPoint &b = v[(i + 1) % n];
+            const FixedPoint &c = v[(i + 2) % n];
+            long long cross = (long long)(b.x - a.x) * (c.y - b.y) - (long long)(b.y - a.y) * (c.x - b.x);
+            long long dot = (long long)(b.x - a.x) * (c.x - b.x) + (long long)(b.y - a.y) * (c.y - b.y);
+            if (cross == 0 && dot < 0)
+            {
+                // Turning back along the same line.
+                return false;
+            }
+            int t = (cross > 0) - (cross < 0);
+            if (t != 0)
+            {
+                if (turn != 0 && t != turn)
+                {
+                    return false;
+                }
+                turn = t;
+            }
+            int dir = (b.y > a.y) - (b.y < a.y);
+            if (dir != 0)
+            {
+                if (last_dir != 0 && dir != last_dir)
+                {
+                    dir_changes++;
+                }
+                if (first_dir == 0)
+                {
+                    first_dir = dir;
+                }
+                last_dir = dir;
+            }
+        }
+        if (first_dir != 0 && first_dir != last_dir)
+        {
+            dir_changes++;
+        }
+        return dir_changes <= 2;
+    }
 }
@@ -2,6 +2,9 @@
 #ifndef __svg_point_hpp__
 #define __svg_point_hpp__
 
+#include <cmath>
+#include <vector>
+
 namespace svg
 {
     //! 2D Point struct, with a few convenience member functions (can be defined for structs too).
@@ -27,5 +30,143 @@ namespace svg
         //! @return Scaling result.
         Point scale(const Point &origin, int v) const;
     };
+
+    //! 2D point with sub-pixel coordinates, used for anti-aliased fills and stroke outlines.
+    struct Vertex
+    {
+        //! X coordinate.
+        double x;
+        //! Y coordinate.
+        double y;
+    };
+
+    //! Fixed-point number with FIXED_SHIFT fractional bits (24.8).
+    typedef int fixed_value;
+    //! Number of fractional bits of a fixed_value.
+    const int FIXED_SHIFT = 8;
+    //! The fixed_value for 1.
+    const fixed_value FIXED_ONE = 1 << FIXED_SHIFT;
+
+    //! Convert an integer to fixed-point.
+    inline fixed_value to_fixed(int v) { return v * FIXED_ONE; }
+    //! Convert a double to fixed-point, rounding to the nearest 1/256.
+    inline fixed_value to_fixed(double v) { return (fixed_value)::lround(v * FIXED_ONE); }
+    //! Convert a fixed-point value to double.
+    inline double fixed_to_double(fixed_value v) { return (double)v / FIXED_ONE; }
+    //! Round a fixed-point value to the nearest integer, halves up, so that
+    //! rounding commutes with integer translations.
+    inline int fixed_round(fixed_value v) { return (v + FIXED_ONE / 2) >> FIXED_SHIFT; }
+    //! Smallest integer not less than a fixed-point value.
+    inline int fixed_ceil(fixed_value v) { return (v + FIXED_ONE - 1) >> FIXED_SHIFT; }
+    //! Largest integer not greater than a fixed-point value.
+    inline int fixed_floor(fixed_value v) { return v >> FIXED_SHIFT; }
+
+    //! Rotation angle with its sine and cosine computed once.
+    struct Rotation
+    {
+        //! Cosine of the angle.
+        double c;
+        //! Sine of the angle.
+        double s;
+
+        //! Rotation by the given angle.
+        //! @param degrees Degrees of rotation.
+        //! @return The rotation.
+        static Rotation degrees(double degrees);
+    };
+
+    //! Affine map (x, y) -> (a x + b y + c, d x + e y + f).
+    struct Affine
+    {
+        double a, b, c;
+        double d, e, f;
+
+        //! Identity map.
+        //! @return The map.
+        static Affine identity();
+        //! Map a vertex.
+        //! @param p Vertex.
+        //! @return Mapped vertex.
+        Vertex apply(const Vertex &p) const;
+        //! Composition applying other first, then this map.
+        //! @param other Map applied first.
+        //! @return The composed map.
+        Affine operator*(const Affine &other) const;
+        //! Inverse map. The map must be invertible.
+        //! @return The inverse.
+        Affine inverse() const;
+    };
+
+    //! 2D point in 24.8 fixed-point coordinates, as carried from parsing to
+    //! rasterization. Integer coordinates are pixel centers.
+    struct FixedPoint
+    {
+        //! X coordinate.
+        fixed_value x;
+        //! Y coordinate.
+        fixed_value y;
+
+        //! Point with integer coordinates.
+        //! @param p Integer point.
+        //! @return The same point in fixed-point.
+        static FixedPoint from(const Point &p);
+        //! Translate a point.
+        //! @param t translation direction.
+        //! @return Translation result.
+        FixedPoint translate(const FixedPoint &t) const;
+        //! Rotate a point. The rotated offset from the origin is rounded to whole
+        //! pixels if the offset is whole pixels, and to the nearest 1/256 otherwise.
+        //! @param origin Rotation origin.
+        //! @param r Rotation.
+        //! @return Rotation result.
+        FixedPoint rotate(const FixedPoint &origin, const Rotation &r) const;
+        //! Scale a point (rounded to the nearest 1/256).
+        //! @param origin Scaling origin.
+        //! @param v Scale amount.
+        //! @return Scaling result.
+        FixedPoint scale(const FixedPoint &origin, double v) const;
+        //! Round to the nearest pixel.
+        //! @return Integer point.
+        Point round() const;
+        //! Convert to a sub-pixel vertex.
+        //! @return Vertex with the same coordinates.
+        Vertex vertex() const;
+    };
+
+    //! Axis-aligned bounding box in fixed-point coordinates, inclusive.
+    struct BoundingBox
+    {
+        //! Minimum corner.
+        fixed_value x0, y0;
+        //! Maximum corner (x1 < x0 for an empty box).
+        fixed_value x1, y1;
+
+        //! Empty box.
+        //! @return A box containing nothing.
+        static BoundingBox empty();
+        //! Check if the box is empty.
+        //! @return True if empty.
+        bool is_empty() const;
+        //! Grow the box to contain a point.
+        //! @param p Point.
+        void add(const FixedPoint &p);
+        //! Grow the box to contain another box.
+        //! @param b Box.
+        void add(const BoundingBox &b);
+        //! Box grown by a margin on every side.
+        //! @param d Margin.
+        //! @return Grown box.
+        BoundingBox expand(fixed_value d) const;
+        //! Check if two boxes overlap.
+        //! @param b Other box.
+        //! @return True if they share at least a point.
+        bool intersects(const BoundingBox &b) const;
+    };
+
+    //! Check if a polygon is convex: all its turns have the same direction and
+    //! it goes down and up only once, so each row meets it in one interval.
+    //! @param points Polygon vertices.
+    //! @return True if the polygon is convex.
+    bool is_convex(const std::vector<FixedPoint> &points);
 }
 #endif
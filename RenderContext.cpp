@@ -0,0 +1,52 @@
+#include "RenderContext.hpp"
+#include "Trace.hpp"
+
+namespace svg
+{
+    void RenderContext::convert(const std::string &svg_file, const std::string &png_file,
+                                const RenderOptions &options, OptimizeStats *stats)
+    {
+        trace::Session session;
+        {
+            TRACE_SCOPE("convert", "convert");
+            load(svg_file);
+            build(options, stats);
+            render(options).save(png_file);
+        }
+    }
+
+    void RenderContext::load(const std::string &svg_file)
+    {
+        {
+            TRACE_SCOPE("cleanup", "convert");
+            // Deletes the elements, but the vector keeps its capacity.
+            scene_.clear();
+        }
+        load_document(svg_file, doc_);
+    }
+
+    void RenderContext::build(const RenderOptions &options, OptimizeStats *stats)
+    {
+        scene_.clear();
+        load_scene(doc_, options, scene_, stats);
+    }
+
+    PNGImage &RenderContext::render(const RenderOptions &options)
+    {
+        if (image_ == nullptr || image_->storage() != options.storage)
+        {
+            image_.reset(new PNGImage(scene_.width, scene_.height, options.storage));
+        }
+        else
+        {
+            image_->reset(scene_.width, scene_.height);
+        }
+        image_->set_antialiasing(options.antialiasing);
+        TRACE_SCOPE("raster", "convert");
+        for (SVGElement *e : scene_.elements)
+        {
+            e->draw(*image_);
+        }
+        return *image_;
+    }
+}
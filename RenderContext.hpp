@@ -0,0 +1,65 @@
+//! @file RenderContext.hpp
+#ifndef __svg_RenderContext_hpp__
+#define __svg_RenderContext_hpp__
+
+#include "SVGElements.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+#include <memory>
+#include <string>
+
+namespace svg
+{
+    //! Converts SVG files one after another, keeping the memory of each
+    //! conversion for the next one: the XML document, the element list, the
+    //! pixels of the image (reallocated only when an image has more pixels than
+    //! any before it) and the scratch buffers of the drawing functions. After
+    //! the first few conversions of similar documents, a conversion allocates
+    //! little besides the elements themselves and the PNG encoder's buffers.
+    //! A context is used by one thread at a time; use one context per thread
+    //! to convert files concurrently.
+    class RenderContext
+    {
+    public:
+        RenderContext() = default;
+        RenderContext(const RenderContext &) = delete;
+        RenderContext &operator=(const RenderContext &) = delete;
+
+        //! Convert an SVG file to PNG, as svg::convert does.
+        //! @param svg_file Input SVG file.
+        //! @param png_file Output PNG file.
+        //! @param options Rendering options.
+        //! @param stats If not null and options.optimize is set, receives what the optimizer did.
+        void convert(const std::string &svg_file,
+                     const std::string &png_file,
+                     const RenderOptions &options = RenderOptions(),
+                     OptimizeStats *stats = nullptr);
+        //! The first step of convert: load an SVG file, deleting the elements
+        //! of the previous one.
+        //! @param svg_file Input SVG file.
+        void load(const std::string &svg_file);
+        //! The second step of convert: build the scene of the loaded file
+        //! (see load_scene).
+        //! @param options Rendering options.
+        //! @param stats If not null and options.optimize is set, receives what the optimizer did.
+        void build(const RenderOptions &options, OptimizeStats *stats = nullptr);
+        //! The third step of convert: draw the scene on the image, which is
+        //! reset to the scene size.
+        //! @param options Rendering options (antialiasing and storage are used).
+        //! @return The image, valid until the next call.
+        PNGImage &render(const RenderOptions &options);
+
+        //! Get the scene of the last build.
+        //! @return The scene.
+        const Scene &scene() const { return scene_; }
+
+    private:
+        //! XML document, reloaded for each file.
+        tinyxml2::XMLDocument doc_;
+        //! Elements of the last document.
+        Scene scene_;
+        //! Image, reset for each drawing (null until the first one).
+        std::unique_ptr<PNGImage> image_;
+    };
+}
+#endif
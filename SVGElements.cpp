@@ -1,11 +1,14 @@
 #include "SVGElements.hpp"
+#include "Trace.hpp"
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 namespace svg
 {
-    Point parse_tstring(std::istringstream& transform_string) {
-        int t_x = 0,t_y = 0,temp;
+    FixedPoint parse_tstring(std::istringstream& transform_string) {
+        double t_x = 0,t_y = 0,temp;
         bool first_check = true;
         while (!transform_string.eof()) {
             if (transform_string >> temp)
@@ -18,234 +21,439 @@ namespace svg
                     transform_string.ignore();
                 } 
         }
-        return {t_x, t_y};
+        return {to_fixed(t_x), to_fixed(t_y)};
     }
 
-    SVGElement::SVGElement() {}
+    Transform::Transform()
+        : type(NONE), offset({0,0}), rotation({1,0}), factor(1.0)
+    {
+    }
+
+    Transform::Transform(const char* transform, const char* origin)
+        : Transform()
+    {
+        if (transform == nullptr) return;
+        // Ignoring the '(' and ')'.
+        std::string t_str = transform;
+        std::string t_type = t_str.substr(0,t_str.find("("));
+        std::string t_args = t_str.substr(t_str.find("(")+1,t_str.find(")"));
+        std::istringstream iss(t_args);
+        if (t_type == "translate")
+        {
+            type = TRANSLATE;
+            offset = parse_tstring(iss);
+            return;
+        }
+        if (origin != nullptr)
+        {
+            std::istringstream origin_iss(origin);
+            offset = parse_tstring(origin_iss);
+        }
+        if (t_type == "rotate")
+        {
+            type = ROTATE;
+            // Sine and cosine are computed once for all points.
+            rotation = Rotation::degrees(stod(t_args));
+        }
+        else if (t_type == "scale")
+        {
+            type = SCALE;
+            factor = stod(t_args);
+        }
+    }
+
+    Transform Transform::view(const FixedPoint& origin, double scale) {
+        Transform t;
+        t.type = VIEW;
+        t.offset = origin;
+        t.factor = scale;
+        return t;
+    }
+
+    FixedPoint Transform::apply(const FixedPoint& p) const {
+        switch (type)
+        {
+        case TRANSLATE:
+            return p.translate(offset);
+        case ROTATE:
+            return p.rotate(offset, rotation);
+        case SCALE:
+            return p.scale(offset, factor);
+        case VIEW:
+            return p.scale(offset, factor).translate({-offset.x, -offset.y});
+        default:
+            return p;
+        }
+    }
+
+    Affine Transform::matrix() const {
+        double ox = fixed_to_double(offset.x), oy = fixed_to_double(offset.y);
+        switch (type)
+        {
+        case TRANSLATE:
+            return {1, 0, ox, 0, 1, oy};
+        case ROTATE:
+            // p -> origin + R (p - origin).
+            return {rotation.c, -rotation.s, ox - rotation.c * ox + rotation.s * oy,
+                    rotation.s, rotation.c, oy - rotation.s * ox - rotation.c * oy};
+        case SCALE:
+            return {factor, 0, ox * (1 - factor), 0, factor, oy * (1 - factor)};
+        case VIEW:
+            return {factor, 0, -factor * ox, 0, factor, -factor * oy};
+        default:
+            return Affine::identity();
+        }
+    }
+
+    fixed_value Transform::scale_length(fixed_value length) const {
+        return (fixed_value)::lround(length * factor);
+    }
+
+    double Transform::linear_scale() const {
+        return type == SCALE || type == VIEW ? factor : 1.0;
+    }
+
+    bool Transform::is_view() const {
+        return type == VIEW;
+    }
+
+    bool Transform::is_translation(FixedPoint& t) const {
+        if (type == TRANSLATE)
+        {
+            t = offset;
+            return true;
+        }
+        if (type == VIEW && factor == 1.0)
+        {
+            t = {-offset.x, -offset.y};
+            return true;
+        }
+        return false;
+    }
+
+    SVGElement::SVGElement() : opacity(1.0) {}
     SVGElement::~SVGElement() {}
-    void SVGElement::transform(const char* transform, const char* origin){}
 
-    void SVGElement::set_point(Point& p,Point NewPoint){
+    void SVGElement::set_opacity(double opacity){
+        this->opacity = std::min(1.0, std::max(0.0, opacity));
+    }
+    double SVGElement::get_opacity() const{ return opacity; }
+    int SVGElement::get_alpha() const{ return (int)::lround(opacity * 255); }
+    void SVGElement::transform(const char* transform, const char* origin){
+        if (transform != nullptr) apply_transform(Transform(transform, origin));
+    }
+
+    bool SVGElement::visible(const BoundingBox& region, fixed_value min_size) const{
+        BoundingBox bounds = get_bounds();
+        // One pixel of margin covers outline rounding and anti-aliased edges.
+        if (!bounds.expand(FIXED_ONE).intersects(region)) return false;
+        return bounds.x1 - bounds.x0 >= min_size || bounds.y1 - bounds.y0 >= min_size;
+    }
+
+    void SVGElement::cull(const BoundingBox& region, fixed_value min_size){}
+
+    SVGElement* SVGElement::clone_visible(const BoundingBox& region, fixed_value min_size) const{
+        return visible(region, min_size) ? clone() : nullptr;
+    }
+
+    void SVGElement::collect_shapes(std::vector<const SVGElement*>& shapes) const{
+        shapes.push_back(this);
+    }
+
+    void SVGElement::share_geometry(GeometryPool&){}
+
+    bool SVGElement::empty() const{ return get_alpha() <= 0; }
+
+    bool SVGElement::covers(const BoundingBox&, bool) const{ return false; }
+
+    void SVGElement::set_point(FixedPoint& p,FixedPoint NewPoint){
         p.x = NewPoint.x; p.y = NewPoint.y;
     }
 
     // Implementation of the member functions of the Ellipse object.
-    Ellipse::Ellipse(const Point &center,
-                     const Point &radius,
+    Ellipse::Ellipse(const FixedPoint &center,
+                     const FixedPoint &radius,
                      const Color &fill
                     )
-        : fill(fill), center(center), radius(radius)
+        : fill(fill), center(center), radius(radius), orientation({1, 0})
     {
     }
 
     //Acessors.
-    Point Ellipse::get_center() const{return center;}
-    Point Ellipse::get_radius() const{return radius;}
-    Color Ellipse::get_fill()const{return fill;}
+    FixedPoint Ellipse::get_center() const{return center;}
+    FixedPoint Ellipse::get_radius() const{return radius;}
+    Rotation Ellipse::get_orientation() const{return orientation;}
+    Color Ellipse::get_fill()const{return fill.color;}
+    void Ellipse::set_gradient(const std::shared_ptr<const Gradient>& gradient){ fill.gradient = gradient; }
 
     void Ellipse::draw(PNGImage &img) const
     {
-        img.draw_ellipse(center, radius, fill);
+        TRACE_SCOPE("Ellipse::draw", "draw");
+        img.draw_ellipse(center, radius, orientation, fill, get_alpha());
     }
 
     SVGElement* Ellipse::clone() const {
         return new Ellipse(*this);
     }
 
-    void Ellipse::transform(const char* transform, const char* origin){
-        if (transform != nullptr)
-        {
-            // Ignoring the '(' and ')'.
-            std::string t_str = transform;
-            std::string t_type = t_str.substr(0,t_str.find("("));
-            std::string t_args = t_str.substr(t_str.find("(")+1,t_str.find(")"));
-            // Variable setup.
-            std::istringstream iss(t_args);
-            Point t_point;
-            // Translate operation.
-            if (t_type == "translate")
-            {
-                t_point = parse_tstring(iss);
-                set_point(center,center.translate(t_point));               
-            }
-            // Rotate operation.
-            if (t_type == "rotate")
-            {
-                if (origin != nullptr)
-                {
-                    std::istringstream origin_iss(origin);
-                    t_point = parse_tstring(origin_iss);   
-                }
-                int angle = stoi(t_args);
-                set_point(center,center.rotate(t_point,angle));
-            }
-            // Scale operation.
-            if (t_type == "scale")
-            {
-                if (origin != nullptr)
-                {
-                    std::istringstream origin_iss(origin);
-                    t_point = parse_tstring(origin_iss);
-                }
-                int scalar = stoi(t_args);
-                set_point(center,center.scale(t_point,scalar));
-                radius.x *= scalar; radius.y*=scalar;
-            }
-        }
+    void Ellipse::apply_transform(const Transform& t){
+        Affine m = t.matrix();
+        fill.transform(m);
+        set_point(center,t.apply(center));
+        radius.x = t.scale_length(radius.x); radius.y = t.scale_length(radius.y);
+        // Circles look the same in any orientation.
+        if (radius.x == radius.y) { orientation = {1, 0}; return; }
+        // Turn the X axis with the linear part of the map.
+        double ux = m.a * orientation.c + m.b * orientation.s;
+        double uy = m.d * orientation.c + m.e * orientation.s;
+        double length = std::hypot(ux, uy);
+        if (length == 0) return;
+        orientation = {ux / length, uy / length};
+        // Quarter turns give axis-aligned ellipses again; keep them exact.
+        const double AXIS_EPSILON = 1e-9;
+        if (std::fabs(orientation.s) < AXIS_EPSILON) orientation = {1, 0};
+        else if (std::fabs(orientation.c) < AXIS_EPSILON) { std::swap(radius.x, radius.y); orientation = {1, 0}; }
+    }
+
+    BoundingBox Ellipse::get_bounds() const{
+        if (orientation.s == 0)
+            return {center.x - radius.x, center.y - radius.y, center.x + radius.x, center.y + radius.y};
+        double rx = radius.x, ry = radius.y, c = orientation.c, s = orientation.s;
+        fixed_value ex = (fixed_value)std::ceil(std::sqrt(rx * rx * c * c + ry * ry * s * s));
+        fixed_value ey = (fixed_value)std::ceil(std::sqrt(rx * rx * s * s + ry * ry * c * c));
+        return {center.x - ex, center.y - ey, center.x + ex, center.y + ey};
+    }
+
+    bool Ellipse::contains(const FixedPoint& p) const{
+        if (radius.x <= 0 || radius.y <= 0) return false;
+        double dx = p.x - center.x, dy = p.y - center.y;
+        double vx = (dx * orientation.c + dy * orientation.s) / radius.x;
+        double vy = (dy * orientation.c - dx * orientation.s) / radius.y;
+        return vx * vx + vy * vy <= 1;
     }
 
     // Implementation of the member functions of the circle object.
-    Circle::Circle(const Point &center,const int& radius ,const Color& fill)
+    Circle::Circle(const FixedPoint &center,const fixed_value& radius ,const Color& fill)
                 : Ellipse(center,{radius,radius},fill){}
     
     void Circle::draw(PNGImage &img){
-        img.draw_ellipse(get_center(), get_radius(), get_fill());
+        img.draw_ellipse(get_center(), get_radius(), get_fill(), get_alpha());
     }
 
     
     // Implementation of the member functions of the Polygon object.
-    Polygon::Polygon(const std::vector<Point>& points, const Color &fill) : points(points), fill(fill) {}
+    Polygon::Polygon(const std::vector<FixedPoint>& points, const Color &fill)
+        : points(points), fill(fill), convex(svg::is_convex(points)) {}
 
     // Acessors
-    std::vector<Point> Polygon::get_points() const{ return points;}
-    Color Polygon::get_fill() const{ return fill;}
+    std::vector<FixedPoint> Polygon::get_points() const{ return points.to_vector();}
+    void Polygon::copy_points(std::vector<FixedPoint>& out) const{ points.copy_to(out);}
+    Color Polygon::get_fill() const{ return fill.color;}
+    void Polygon::set_gradient(const std::shared_ptr<const Gradient>& gradient){ fill.gradient = gradient; }
+    bool Polygon::has_gradient() const{ return fill.gradient != nullptr; }
+    bool Polygon::is_convex() const{ return convex;}
 
     void Polygon::draw(PNGImage &img) const {
-        img.draw_polygon(points, fill);
+        TRACE_SCOPE("Polygon::draw", "draw");
+        draw_fill(img);
+    }
+
+    void Polygon::draw_fill(PNGImage &img) const {
+        std::vector<FixedPoint> &buffer = img.point_buffer();
+        points.copy_to(buffer);
+        if (convex)
+        {
+            img.draw_convex_polygon(buffer, fill, get_alpha());
+            return;
+        }
+        img.draw_polygon(buffer, fill, get_alpha());
     }
 
     SVGElement* Polygon::clone() const {
         return new Polygon(*this);
     }
 
-    void Polygon::transform(const char* transform, const char* origin){
-        if (transform != nullptr)
+    void Polygon::apply_transform(const Transform& t){
+        fill.transform(t.matrix());
+        FixedPoint offset;
+        if (t.is_translation(offset))
         {
-            // Ignoring the '(' and ')'
-            std::string t_str = transform;
-            std::string t_type = t_str.substr(0,t_str.find("("));
-            std::string t_args = t_str.substr(t_str.find("(")+1,t_str.find(")"));
-            // Variable setup
-            std::istringstream iss(t_args);
-            Point t_point = {0,0};
-            // Translate operation
-            if (t_type == "translate")
-            {
-                t_point = parse_tstring(iss);
-                for (Point& p : points)
-                {
-                    set_point(p,p.translate({t_point}));
-                }
-            }
-            // Rotate operation
-            if (t_type == "rotate")
-            {
-                if (origin != nullptr)
-                {
-                    std::istringstream origin_iss(origin);
-                    t_point = parse_tstring(origin_iss);  
-                }
-                int angle = stoi(t_args);
-                for (Point& p : points)
-                {
-                    set_point(p,p.rotate(t_point,angle));
-                }
-            }
-            // Scale operation
-            if (t_type == "scale")
+            // Shared storage stays shared, and convexity is unchanged.
+            points.translate(offset);
+            return;
+        }
+        std::vector<FixedPoint> moved = points.to_vector();
+        for (FixedPoint& p : moved)
+        {
+            set_point(p,t.apply(p));
+        }
+        // Rounding rotated points to the pixel grid may break convexity.
+        convex = svg::is_convex(moved);
+        points = PointList(moved);
+    }
+
+    BoundingBox Polygon::get_bounds() const{
+        BoundingBox bounds = BoundingBox::empty();
+        for (size_t i = 0; i < points.size(); i++) bounds.add(points[i]);
+        return bounds;
+    }
+
+    // Squared distance from p to segment a-b.
+    double segment_distance2(const FixedPoint& p, const FixedPoint& a, const FixedPoint& b){
+        Vertex v = p.vertex(), va = a.vertex(), vb = b.vertex();
+        double dx = vb.x - va.x, dy = vb.y - va.y;
+        double len2 = dx * dx + dy * dy;
+        double t = len2 > 0 ? ((v.x - va.x) * dx + (v.y - va.y) * dy) / len2 : 0;
+        t = std::min(1.0, std::max(0.0, t));
+        double ex = va.x + t * dx - v.x, ey = va.y + t * dy - v.y;
+        return ex * ex + ey * ey;
+    }
+
+    bool Polygon::contains(const FixedPoint& p) const{
+        double margin = fixed_to_double(HIT_MARGIN);
+        bool inside = false;
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            FixedPoint a = points[i];
+            FixedPoint b = points[(i + 1) % points.size()];
+            // The outline is painted too.
+            if (segment_distance2(p, a, b) <= margin * margin) return true;
+            // Crossing of the horizontal ray to the right of p, half-open in y.
+            if ((a.y > p.y) != (b.y > p.y))
             {
-                if (origin != nullptr)
-                {
-                    std::istringstream origin_iss(origin);
-                    t_point = parse_tstring(origin_iss);
-                }
-                int scalar = stoi(t_args);
-                for (Point& p : points)
-                {
-                    set_point(p,p.scale(t_point,scalar));
-                }
+                long long lhs = (long long)(p.x - a.x) * (b.y - a.y);
+                long long rhs = (long long)(b.x - a.x) * (p.y - a.y);
+                if ((b.y > a.y) ? lhs < rhs : lhs > rhs) inside = !inside;
             }
         }
+        return inside;
+    }
+
+    void Polygon::share_geometry(GeometryPool& pool){
+        points = pool.intern(points);
+    }
+
+    bool Polygon::empty() const{
+        return points.size() == 0 || SVGElement::empty();
+    }
+
+    bool Polygon::covers(const BoundingBox& region, bool antialiasing) const{
+        if (get_alpha() < 255 || (fill.gradient && !fill.gradient->opaque())) return false;
+        if (points.size() != 4 || !convex) return false;
+        // The four corners of the bounding box, in a convex (non-crossing) order.
+        BoundingBox bounds = get_bounds();
+        int corners = 0;
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            FixedPoint p = points[i];
+            if ((p.x != bounds.x0 && p.x != bounds.x1) || (p.y != bounds.y0 && p.y != bounds.y1)) return false;
+            corners |= 1 << ((p.x == bounds.x1) + 2 * (p.y == bounds.y1));
+        }
+        if (corners != 15) return false;
+        // Aliased fills paint every pixel center inside the outline; anti-aliased
+        // ones fill only the pixels whose square is inside (with a margin for rounding).
+        BoundingBox r = antialiasing ? region.expand(FIXED_ONE) : region;
+        return bounds.x0 <= r.x0 && bounds.y0 <= r.y0 && bounds.x1 >= r.x1 && bounds.y1 >= r.y1;
     }
 
     // Implementation of the member functions of the Rectangle object
-    Rectangle::Rectangle(const Point &topLeft, int width, int height, const Color &fill)
-    : Polygon({topLeft,{topLeft.x + width -1, topLeft.y},{topLeft.x + width -1, topLeft.y + height -1},{topLeft.x, topLeft.y + height -1}},fill) {}
+    Rectangle::Rectangle(const FixedPoint &topLeft, fixed_value width, fixed_value height, const Color &fill)
+    : Polygon({topLeft,{topLeft.x + width - FIXED_ONE, topLeft.y},{topLeft.x + width - FIXED_ONE, topLeft.y + height - FIXED_ONE},{topLeft.x, topLeft.y + height - FIXED_ONE}},fill),
+      width(width), height(height) {}
 
     // Acessors
-    int Rectangle::get_width() const{ return width;}
-    int Rectangle::get_height() const{ return height;}
+    fixed_value Rectangle::get_width() const{ return width;}
+    fixed_value Rectangle::get_height() const{ return height;}
 
     void Rectangle::draw(PNGImage &img) const
     {
-        img.draw_polygon(get_points(),get_fill());
+        TRACE_SCOPE("Rectangle::draw", "draw");
+        draw_fill(img);
     }
 
     //implementation of the member functions of the Polyline object.
-    Polyline::Polyline(const std::vector<Point>& points, const Color &c) : points(points), stroke(c) {}
+    Polyline::Polyline(const std::vector<FixedPoint>& points, const Color &c) : points(points), stroke(c) {}
     void Polyline::draw(PNGImage &img) const 
     {
-        for (size_t i = 0; i < points.size() - 1; i++) 
+        TRACE_SCOPE("Polyline::draw", "draw");
+        draw_stroke(img);
+    }
+
+    void Polyline::draw_stroke(PNGImage &img) const
+    {
+        std::vector<FixedPoint> &buffer = img.point_buffer();
+        points.copy_to(buffer);
+        if (style.hairline)
         {
-            img.draw_line(points[i], points[i + 1], stroke);
+            img.draw_polyline(buffer, stroke, get_alpha());
+            return;
         }
+        std::vector<Contour> &contours = img.contour_buffer();
+        stroke_outline(buffer, style, contours);
+        img.fill_contours(contours, stroke, get_alpha(), FillRule::NonZero);
     }
 
-    std::vector<Point>Polyline::get_points() const { return points; }
+    std::vector<FixedPoint>Polyline::get_points() const { return points.to_vector(); }
+    void Polyline::copy_points(std::vector<FixedPoint>& out) const { points.copy_to(out); }
     Color Polyline::get_color() const { return stroke; }
+    const StrokeStyle &Polyline::get_stroke_style() const { return style; }
+    void Polyline::set_stroke_style(const StrokeStyle &style) { this->style = style; }
 
-    void Polyline::transform(const char* transform, const char* origin){
-        if (transform != nullptr)
-        {   
-            // Ignoring the '(' and ')'.
-            std::string t_str = transform;
-            std::string t_type = t_str.substr(0,t_str.find("("));
-            std::string t_args = t_str.substr(t_str.find("(")+1,t_str.find(")"));
-
-            // Variable setup.
-            std::istringstream iss(t_args);
-            Point t_point = {0,0};
-            // Translate operation.
-            if (t_type == "translate")
+    void Polyline::apply_transform(const Transform& t){
+        FixedPoint offset;
+        if (t.is_translation(offset))
+        {
+            points.translate(offset);
+        }
+        else
+        {
+            std::vector<FixedPoint> moved = points.to_vector();
+            for (FixedPoint& p : moved)
             {
-                t_point = parse_tstring(iss);
-                for (Point& p : points)
-                {
-                    set_point(p,p.translate(t_point));
-                }
+                set_point(p,t.apply(p));
             }
+            points = PointList(moved);
+        }
+        // Strokes scale with the shape, and a stroke made thinner than a pixel
+        // draws a 1-pixel line. Hairlines keep their pixel width under
+        // document transforms and only widen when a view magnifies them.
+        // Strokes that paint nothing stay so.
+        double scale = t.linear_scale();
+        if (scale == 1.0 || !(style.width > 0)) return;
+        if (!style.hairline)
+            style.width = std::max(1.0, style.width * scale);
+        else if (t.is_view() && scale > 1.0)
+        {
+            style.hairline = false;
+            style.width = scale;
+        }
+    }
 
-            // Rotate operation.
-            if (t_type == "rotate")
-            {
-                if (origin != nullptr)
-                    {
-                        std::istringstream origin_iss(origin);
-                        t_point = parse_tstring(origin_iss); 
-                    }
-                int angle;
-                iss >> angle;
-                for (Point& p : points)
-                {
-                    set_point(p,p.rotate(t_point,angle));
-                }
-            
-            // Scale operation.
-            }
-            if (t_type == "scale")
-            {
-                if (origin != nullptr)
-                {
-                    std::istringstream origin_iss(origin);
-                    t_point = parse_tstring(origin_iss); 
-                }
-                int scalar = stoi(t_args);
-                for (Point& p : points)
-                {
-                    set_point(p,p.scale(t_point,scalar));
-                }
-            }
+    BoundingBox Polyline::get_bounds() const{
+        BoundingBox bounds = BoundingBox::empty();
+        for (size_t i = 0; i < points.size(); i++) bounds.add(points[i]);
+        if (style.hairline) return bounds;
+        // Miter joins reach at most miter_limit half widths from the line, square caps sqrt(2).
+        double reach = style.width / 2 * std::max(style.miter_limit, M_SQRT2);
+        return bounds.expand(to_fixed(reach));
+    }
+
+    bool Polyline::contains(const FixedPoint& p) const{
+        double margin = fixed_to_double(HIT_MARGIN);
+        double hw = std::max(style.width / 2, margin);
+        for (size_t i = 0; i + 1 < points.size(); i++)
+        {
+            if (segment_distance2(p, points[i], points[i + 1]) <= hw * hw) return true;
         }
+        return false;
+    }
+
+    void Polyline::share_geometry(GeometryPool& pool){
+        points = pool.intern(points);
+    }
+
+    bool Polyline::empty() const{
+        return points.size() == 0 || !(style.width > 0) || SVGElement::empty();
     }
 
     SVGElement* Polyline::clone() const {
@@ -253,12 +461,89 @@ namespace svg
     }
 
     //implementation of the member functions of the Line object.
-    Line::Line(const std::vector<Point>& points, const Color &c) : Polyline(points, c) {}
+    Line::Line(const std::vector<FixedPoint>& points, const Color &c) : Polyline(points, c) {}
     void Line::draw(PNGImage &img) const {
-        img.draw_line(get_points()[0], get_points()[1], get_color());
+        TRACE_SCOPE("Line::draw", "draw");
+        if (get_stroke_style().hairline)
+        {
+            std::vector<FixedPoint> &ends = img.point_buffer();
+            copy_points(ends);
+            img.draw_line(ends[0], ends[1], get_color(), get_alpha());
+            return;
+        }
+        draw_stroke(img);
     }
 
-    
+    //implementation of the member functions of the Path object.
+    Path::Path(const std::vector<PathVerb>& verbs, const std::vector<FixedPoint>& points, const Color &fill,
+               FillRule rule)
+        : verbs(verbs), points(points), fill(fill), rule(rule) {}
+
+    // Acessors
+    const std::vector<PathVerb>& Path::get_verbs() const { return verbs; }
+    std::vector<FixedPoint> Path::get_points() const { return points.to_vector(); }
+    Color Path::get_fill() const { return fill.color; }
+    void Path::set_gradient(const std::shared_ptr<const Gradient>& gradient) { fill.gradient = gradient; }
+    FillRule Path::get_fill_rule() const { return rule; }
+
+    void Path::draw(PNGImage &img) const {
+        TRACE_SCOPE("Path::draw", "draw");
+        std::vector<FixedPoint> &buffer = img.point_buffer();
+        points.copy_to(buffer);
+        std::vector<Contour> &contours = img.contour_buffer();
+        flatten_path(verbs, buffer, PATH_TOLERANCE, contours);
+        img.fill_contours(contours, fill, get_alpha(), rule);
+    }
+
+    SVGElement* Path::clone() const {
+        return new Path(*this);
+    }
+
+    void Path::apply_transform(const Transform& t){
+        fill.transform(t.matrix());
+        FixedPoint offset;
+        if (t.is_translation(offset))
+        {
+            points.translate(offset);
+            return;
+        }
+        std::vector<FixedPoint> moved = points.to_vector();
+        for (FixedPoint& p : moved)
+        {
+            set_point(p,t.apply(p));
+        }
+        points = PointList(moved);
+    }
+
+    BoundingBox Path::get_bounds() const{
+        BoundingBox bounds = BoundingBox::empty();
+        for (size_t i = 0; i < points.size(); i++) bounds.add(points[i]);
+        return bounds;
+    }
+
+    bool Path::contains(const FixedPoint& p) const{
+        // Hit tests (e.g. SceneIndex::element_at) flatten into buffers kept
+        // by the thread, so that they do not allocate once those have grown.
+        thread_local std::vector<FixedPoint> path_points;
+        thread_local std::vector<Contour> contours;
+        points.copy_to(path_points);
+        flatten_path(verbs, path_points, PATH_TOLERANCE, contours);
+        return contours_contain(contours, p.vertex(), rule);
+    }
+
+    void Path::share_geometry(GeometryPool& pool){
+        points = pool.intern(points);
+    }
+
+    bool Path::empty() const{
+        for (PathVerb verb : verbs)
+        {
+            if (verb != PathVerb::MoveTo && verb != PathVerb::Close) return SVGElement::empty();
+        }
+        return true;
+    }
+
+
     //implementation of the member functions for a group of objects.
     Group::Group(const std::vector<SVGElement*>& elements) {
         for (SVGElement* element : elements)
@@ -276,25 +561,139 @@ namespace svg
     }
 
     void Group::draw(PNGImage &img) const{
+        TRACE_SCOPE("Group::draw", "draw");
+        int alpha = get_alpha();
+        if (alpha <= 0) return;
+        // A translucent group is drawn opaquely over a copy of the backdrop and
+        // then mixed with it, which equals compositing the group as a layer.
+        // Only the pixels within the bounds of the group can change.
+        PixelRect rect = {0, 0, 0, 0};
+        if (alpha < 255)
+        {
+            rect = img.pixel_rect(get_bounds());
+            img.push_backdrop(rect);
+        }
         for ( SVGElement* element : group_elements)
         {
             element->draw(img);
         }
+        if (alpha < 255) img.pop_backdrop(rect, alpha);
     }
 
-    void Group::transform(const char* transform, const char* origin){
+    void Group::apply_transform(const Transform& t){
         for ( SVGElement* element : group_elements)
         {
-            element->transform(transform,origin);
+            element->apply_transform(t);
+        }
+    }
+
+    BoundingBox Group::get_bounds() const{
+        BoundingBox bounds = BoundingBox::empty();
+        for (const SVGElement* element : group_elements) bounds.add(element->get_bounds());
+        return bounds;
+    }
+
+    bool Group::contains(const FixedPoint& p) const{
+        for (const SVGElement* element : group_elements)
+        {
+            if (element->contains(p)) return true;
+        }
+        return false;
+    }
+
+    void Group::collect_shapes(std::vector<const SVGElement*>& shapes) const{
+        for (const SVGElement* element : group_elements)
+        {
+            element->collect_shapes(shapes);
+        }
+    }
+
+    void Group::share_geometry(GeometryPool& pool){
+        for (SVGElement* element : group_elements)
+        {
+            element->share_geometry(pool);
         }
     }
+
+    GeometryStats share_geometry(const std::vector<SVGElement*>& svg_elements){
+        TRACE_SCOPE("share_geometry", "convert");
+        GeometryPool pool;
+        for (SVGElement* element : svg_elements)
+        {
+            element->share_geometry(pool);
+        }
+        return pool.stats();
+    }
+
+    void Group::cull(const BoundingBox& region, fixed_value min_size){
+        size_t n = 0;
+        for (SVGElement* element : group_elements)
+        {
+            if (element->visible(region, min_size))
+            {
+                element->cull(region, min_size);
+                group_elements[n++] = element;
+            }
+            else
+            {
+                delete element;
+            }
+        }
+        group_elements.resize(n);
+    }
     
+    bool Group::empty() const{
+        return group_elements.empty() || SVGElement::empty();
+    }
+
+    std::vector<SVGElement*>& Group::get_elements(){ return group_elements; }
+    const std::vector<SVGElement*>& Group::get_elements() const{ return group_elements; }
+
     SVGElement* Group::clone() const {
         std::vector<SVGElement*> clone_elements;
         for (const SVGElement* element : group_elements) {
             clone_elements.push_back(element->clone());
         }
-        return new Group(clone_elements);
+        return copy_with(clone_elements);
     }
-    
-}
\ No newline at end of file
+
+    SVGElement* Group::clone_visible(const BoundingBox& region, fixed_value min_size) const {
+        if (!visible(region, min_size)) return nullptr;
+        std::vector<SVGElement*> clone_elements;
+        for (const SVGElement* element : group_elements) {
+            SVGElement* clone = element->clone_visible(region, min_size);
+            if (clone != nullptr) clone_elements.push_back(clone);
+        }
+        if (clone_elements.empty()) return nullptr;
+        return copy_with(clone_elements);
+    }
+
+    Group* Group::copy_with(const std::vector<SVGElement*>& elements) const {
+        Group* group = new Group(elements);
+        group->set_opacity(get_opacity());
+        return group;
+    }
+
+    // Implementation of the member functions of the PolygonBatch object.
+    PolygonBatch::PolygonBatch(const std::vector<SVGElement*>& polygons, const Color& fill)
+        : Group(polygons), fill(fill) {}
+
+    Group* PolygonBatch::copy_with(const std::vector<SVGElement*>& elements) const {
+        return new PolygonBatch(elements, fill);
+    }
+
+    void PolygonBatch::draw(PNGImage &img) const{
+        TRACE_SCOPE("PolygonBatch::draw", "draw");
+        const std::vector<SVGElement*>& elements = get_elements();
+        std::vector<std::vector<FixedPoint>> &polygons = img.polygon_buffer();
+        // Polygons left over from a larger batch are emptied rather than
+        // freed; they draw nothing.
+        if (polygons.size() < elements.size()) polygons.resize(elements.size());
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            static_cast<const Polygon*>(elements[i])->copy_points(polygons[i]);
+        }
+        for (size_t i = elements.size(); i < polygons.size(); i++) polygons[i].clear();
+        img.draw_polygons(polygons, fill);
+    }
+}
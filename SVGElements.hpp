@@ -3,33 +3,328 @@
 #define __svg_SVGElements_hpp__
 
 #include "Color.hpp"
+#include "Geometry.hpp"
+#include "Path.hpp"
 #include "Point.hpp"
 #include "PNGImage.hpp"
+#include "Stroke.hpp"
+
+namespace tinyxml2
+{
+    class XMLDocument;
+}
 
 namespace svg
 {
+    //! Parsed transform attribute (translate, rotate or scale), or a view
+    //! transform mapping a document region to the output image, applied point by point.
+    class Transform
+    {
+    public:
+        //! Parse a transform. If transform = nullpointer -> identity. If origin = nullpointer -> origin = (0,0).
+        //! @param transform pointer from the transform attribute.
+        //! @param origin pointer from the transform-origin attribute.
+        Transform(const char* transform, const char* origin);
+        //! View transform: p -> (p - origin) * scale. Unlike scale transforms,
+        //! it also widens hairlines (see StrokeStyle::hairline).
+        //! @param origin Document point mapped to (0, 0).
+        //! @param scale Scale factor.
+        //! @return The transform.
+        static Transform view(const FixedPoint& origin, double scale);
+        //! Transform a point.
+        //! @param p Point.
+        //! @return Transformed point.
+        FixedPoint apply(const FixedPoint& p) const;
+        //! Scale a length (e.g. a radius); only scale and view transforms change it.
+        //! @param length Length.
+        //! @return Scaled length.
+        fixed_value scale_length(fixed_value length) const;
+        //! Factor applied to lengths such as stroke widths (1 for
+        //! translations and rotations).
+        //! @return The factor.
+        double linear_scale() const;
+        //! Check if this is a view transform (see view).
+        //! @return True for views.
+        bool is_view() const;
+        //! Check if the transform only translates points.
+        //! @param t Output translation, if so.
+        //! @return True for translations, and views with a scale of 1.
+        bool is_translation(FixedPoint& t) const;
+        //! Exact affine map of the transform, without the rounding of rotated
+        //! offsets done by apply; used to move gradients with their shapes.
+        //! @return The map.
+        Affine matrix() const;
+
+    private:
+        enum Type { NONE, TRANSLATE, ROTATE, SCALE, VIEW };
+        //! Identity transform.
+        Transform();
+        // Transform type.
+        Type type;
+        // Translation, or origin of the rotation, scale or view.
+        FixedPoint offset;
+        // Rotation, with its sine and cosine.
+        Rotation rotation;
+        // Scale factor.
+        double factor;
+    };
+
     class SVGElement
     {
 
     public:
+        //! Reach of hit testing beyond the bounds (half a pixel wide outline).
+        static const fixed_value HIT_MARGIN = FIXED_ONE / 2;
+
         SVGElement();
         virtual ~SVGElement();
         virtual void draw(PNGImage &img) const = 0;
-        virtual void transform(const char* transform, const char* origin);
-
-        void set_point(Point& p,Point NewPoint);
+        //! @brief Transform SVGElement. If transform = nullpointer -> Leads to no changes made. If origin = nullpointer -> origin = (0,0).
+        //! @param transform pointer from the transform attribute.
+        //! @param origin pointer from the transform-origin attribute.
+        void transform(const char* transform, const char* origin);
+        //! Apply a parsed transform to the element geometry.
+        //! @param t Transform.
+        virtual void apply_transform(const Transform& t) = 0;
+        //! Bounding box of the element geometry, including stroke widths.
+        //! @return The bounding box (empty for an empty group).
+        virtual BoundingBox get_bounds() const = 0;
+        //! Check if the element can change pixels of a region and is not too small.
+        //! @param region Region, e.g. the image area.
+        //! @param min_size Elements whose bounding box is smaller than this in
+        //! both directions are not visible.
+        //! @return True if the element should be drawn.
+        bool visible(const BoundingBox& region, fixed_value min_size) const;
+        //! Remove the invisible parts of the element (see visible); only groups have any.
+        //! @param region Region.
+        //! @param min_size Minimum size.
+        virtual void cull(const BoundingBox& region, fixed_value min_size);
+        //! Check if a point is inside the painted shape. One pixel wide outlines
+        //! reach up to HIT_MARGIN outside get_bounds().
+        //! @param p Point.
+        //! @return True if the point is inside.
+        virtual bool contains(const FixedPoint& p) const = 0;
+        //! Append the shapes making up the element in paint order: the element
+        //! itself, or the shapes of all members for a group.
+        //! @param shapes Output shapes.
+        virtual void collect_shapes(std::vector<const SVGElement*>& shapes) const;
+        //! Share point storage with the equal geometry (up to a translation)
+        //! interned before; does nothing for shapes without point lists.
+        //! @param pool Geometry pool.
+        virtual void share_geometry(GeometryPool& pool);
+        //! Check if drawing the element leaves the image unchanged, whatever
+        //! the image: fully transparent elements, and shapes or groups with
+        //! nothing in them.
+        //! @return True if the element paints nothing.
+        virtual bool empty() const;
+        //! Check if drawing the element overwrites every pixel of a region
+        //! with colors that do not depend on what was drawn before.
+        //! @param region Region, in pixel centers.
+        //! @param antialiasing True if drawn with anti-aliasing.
+        //! @return True if the region is covered.
+        virtual bool covers(const BoundingBox& region, bool antialiasing) const;
+
+        void set_point(FixedPoint& p,FixedPoint NewPoint);
         virtual SVGElement* clone() const = 0;
+        //! Clone the parts of the element that are visible in a region (see
+        //! cull); the invisible members of groups are skipped, not copied.
+        //! @param region Region.
+        //! @param min_size Minimum size.
+        //! @return A dynamically allocated SVGElement, or nullptr if nothing is visible.
+        virtual SVGElement* clone_visible(const BoundingBox& region, fixed_value min_size) const;
+
+        //! Set the element opacity. For shapes this is the paint opacity
+        //! (opacity times fill-opacity or stroke-opacity), for groups the group opacity.
+        //! @param opacity Opacity in [0, 1] (values outside are clamped).
+        void set_opacity(double opacity);
+        //! Acessor for the element opacity.
+        //! @return Opacity in [0, 1].
+        double get_opacity() const;
+
+    protected:
+        //! Opacity as an alpha value in [0, 255], as used by PNGImage.
+        int get_alpha() const;
+
+    private:
+        // Opacity in [0, 1].
+        double opacity;
     };
 
     // Declaration of namespace functions
     // readSVG -> implement it in readSVG.cpp
     // convert -> already given (DO NOT CHANGE) in convert.cpp
 
+    //! Load an SVG file into an XML document (replacing its contents).
+    //! @param svg_file Input SVG file.
+    //! @param doc Output document.
+    void load_document(const std::string &svg_file, tinyxml2::XMLDocument &doc);
+    //! Read an SVG file (see the overload below for jobs).
     void readSVG(const std::string &svg_file,
                  Point &dimensions,
-                 std::vector<SVGElement *> &svg_elements);
+                 std::vector<SVGElement *> &svg_elements,
+                 int jobs = 0);
+    //! Build the elements of an already loaded SVG document. Shapes are built
+    //! concurrently when the document is large enough; the elements are the
+    //! same, in the same order, as with a single thread.
+    //! @param doc Loaded XML document.
+    //! @param dimensions Output canvas dimensions.
+    //! @param svg_elements Output elements.
+    //! @param jobs Maximum number of threads (0: one per hardware thread).
+    void readSVG(tinyxml2::XMLDocument &doc,
+                 Point &dimensions,
+                 std::vector<SVGElement *> &svg_elements,
+                 int jobs = 0);
     void convert(const std::string &svg_file,
                  const std::string &png_file);
+    //! Share the point storage of equal geometry (up to a translation)
+    //! between elements, e.g. right after readSVG.
+    //! @param svg_elements Elements.
+    //! @return Sharing statistics.
+    GeometryStats share_geometry(const std::vector<SVGElement *> &svg_elements);
+    struct OptimizeStats;
+
+    //! Rendering options for convert.
+    struct RenderOptions
+    {
+        //! Anti-aliased rendering (see PNGImage::set_antialiasing).
+        bool antialiasing = false;
+        //! Scale factor from document units to output pixels.
+        double scale = 1.0;
+        //! Document region to render; a zero width or height renders the whole document.
+        double region_x = 0, region_y = 0, region_width = 0, region_height = 0;
+        //! Elements whose bounding box is smaller than this many output
+        //! pixels in both directions are skipped.
+        double min_size = 0;
+        //! Share the storage of repeated point lists (see share_geometry).
+        bool share_geometry = false;
+        //! Threads for element construction (0: one per hardware thread; see readSVG).
+        int jobs = 0;
+        //! Pixel storage of the output image (File for canvases larger than memory).
+        PixelStorage storage = PixelStorage::Memory;
+        //! Simplify the elements before drawing, without changing the image (see optimize_scene).
+        bool optimize = false;
+    };
+    //! Convert an SVG file to PNG with the given rendering options.
+    //! @param svg_file Input SVG file.
+    //! @param png_file Output PNG file.
+    //! @param options Rendering options.
+    //! @param stats If not null and options.optimize is set, receives what the optimizer did.
+    void convert(const std::string &svg_file,
+                 const std::string &png_file,
+                 const RenderOptions &options,
+                 OptimizeStats *stats = nullptr);
+
+    //! One output of a multi-output convert.
+    struct OutputSpec
+    {
+        //! Output PNG file.
+        std::string png_file;
+        //! Scale factor from document units to output pixels.
+        double scale = 1.0;
+        //! Document region to render; a zero width or height renders the whole document.
+        double region_x = 0, region_y = 0, region_width = 0, region_height = 0;
+        //! Pixel format of the file.
+        PixelFormat format = PixelFormat::RGB;
+    };
+    //! Convert an SVG file to several PNG files, e.g. at different sizes or
+    //! crops. The document is read once; each output then draws its own copy
+    //! of the elements, viewed with its scale and region, and the outputs are
+    //! rendered and encoded concurrently. Each file is the same as the one
+    //! written by convert with the output's scale and region. If outputs fail,
+    //! the error of the first one in the list is rethrown once all are done.
+    //! @param svg_file Input SVG file.
+    //! @param outputs Output files with their scale, region and format.
+    //! @param options Rendering options shared by the outputs (scale and
+    //! region are taken from each output); jobs also bounds the number of
+    //! outputs rendered at once (0: one per hardware thread).
+    void convert(const std::string &svg_file,
+                 const std::vector<OutputSpec> &outputs,
+                 const RenderOptions &options);
+
+    //! Elements ready to draw, as prepared by load_scene.
+    struct Scene
+    {
+        Scene() = default;
+        Scene(const Scene &) = delete;
+        Scene &operator=(const Scene &) = delete;
+        ~Scene();
+        //! Delete the elements.
+        void clear();
+
+        //! Output image size.
+        int width = 0, height = 0;
+        //! Elements in output pixel coordinates (owned by the scene).
+        std::vector<SVGElement *> elements;
+    };
+    //! The first half of convert: read an SVG file, compute the output size,
+    //! apply the view, optimize (if enabled) and cull the elements.
+    //! @param svg_file Input SVG file.
+    //! @param options Rendering options.
+    //! @param scene Output scene.
+    //! @param stats If not null and options.optimize is set, receives what the optimizer did.
+    void load_scene(const std::string &svg_file,
+                    const RenderOptions &options,
+                    Scene &scene,
+                    OptimizeStats *stats = nullptr);
+    //! load_scene for an already loaded SVG document.
+    //! @param doc Loaded XML document.
+    //! @param options Rendering options.
+    //! @param scene Output scene (elements are appended to scene.elements).
+    //! @param stats If not null and options.optimize is set, receives what the optimizer did.
+    void load_scene(tinyxml2::XMLDocument &doc,
+                    const RenderOptions &options,
+                    Scene &scene,
+                    OptimizeStats *stats = nullptr);
+
+    //! Options for convert_batch.
+    struct BatchOptions
+    {
+        //! Rendering options, the same for all files.
+        RenderOptions render;
+        //! Threads reading and preparing scenes (0: one per hardware thread).
+        int load_jobs = 1;
+        //! Threads rasterizing (0: one per hardware thread).
+        int raster_jobs = 0;
+        //! Threads encoding and writing PNG files (0: one per hardware thread).
+        int encode_jobs = 1;
+        //! Capacity of the queues between stages; at most this many scenes
+        //! and images wait between stages, besides the ones being worked on.
+        int queue_depth = 2;
+    };
+    //! Convert several SVG files as a pipeline: files are loaded, rasterized
+    //! and encoded by separate pools of threads linked by bounded queues, so
+    //! the stages of different files overlap.
+    //! @param svg_files Input SVG files.
+    //! @param png_files Output PNG files, one per input file.
+    //! @param options Batch options.
+    //! @param errors Output error messages, one per file (empty if converted).
+    //! @return Number of files converted.
+    int convert_batch(const std::vector<std::string> &svg_files,
+                      const std::vector<std::string> &png_files,
+                      const BatchOptions &options,
+                      std::vector<std::string> &errors);
+
+    //! Options for render_tiles.
+    struct TileOptions
+    {
+        //! Rendering options; scale and region are set for each tile.
+        RenderOptions render;
+        //! Tile width and height in pixels.
+        int tile_size = 256;
+        //! Number of rendering threads (0: one per hardware thread).
+        int jobs = 0;
+    };
+    //! Render an SVG file as a tile pyramid, out_dir/z/x/y.png. Level 0 fits
+    //! the document in one tile and each level doubles the scale, up to the
+    //! document size. Tiles are rendered from the geometry, with culling
+    //! against the tile bounds, by several threads.
+    //! @param svg_file Input SVG file.
+    //! @param out_dir Output directory (created if needed).
+    //! @param options Tile options.
+    //! @return Number of tiles written.
+    int render_tiles(const std::string &svg_file,
+                     const std::string &out_dir,
+                     const TileOptions &options);
 
     // ELLIPSE SHAPE
     class Ellipse : public SVGElement
@@ -39,21 +334,34 @@ namespace svg
         //! @param fill Filling Color.
         //! @param center Center point of the ellipse.
         //! @param radius Radius in x and y axis.  
-        Ellipse(const Point &center, const Point &radius, const Color &fill);
+        Ellipse(const FixedPoint &center, const FixedPoint &radius, const Color &fill);
 
         //! Acessor for ellipse's center Point.
         //! @return Center point.
-        Point get_center() const;
+        FixedPoint get_center() const;
         //! Acessor for ellipse's radius on xy axis.
         //! @return radius point per axis (x,y).
-        Point get_radius() const;
+        FixedPoint get_radius() const;
+        //! Acessor for ellipse's orientation: the rotation of its X radius,
+        //! which follows the rotate transforms applied to it.
+        //! @return Orientation (no rotation for circles).
+        Rotation get_orientation() const;
         //! Acessor for ellipse's fill color.
         //! @return Fill color.
         Color get_fill() const;
-        //! @brief Transform SVGElement. If transform = nullpointer -> Leads to no changes made. If origin = nullpointer -> origin = (0,0).
-        //! @param transform pointer from the transform attribute.
-        //! @param origin pointer from the transform-origin attribute.
-        void transform(const char* transform, const char* origin) override;
+        //! Fill the ellipse with a gradient instead of the fill color.
+        //! @param gradient Gradient, in the coordinates of the ellipse.
+        void set_gradient(const std::shared_ptr<const Gradient>& gradient);
+        //! Apply a parsed transform to the ellipse.
+        //! @param t Transform.
+        void apply_transform(const Transform& t) override;
+        //! Bounding box of the ellipse.
+        //! @return The bounding box.
+        BoundingBox get_bounds() const override;
+        //! Check if a point is inside the ellipse.
+        //! @param p Point.
+        //! @return True if inside.
+        bool contains(const FixedPoint& p) const override;
         //! Creates a clone of an element
         //! @return a dynamically allocated SVGElement
         SVGElement* clone() const override;
@@ -62,12 +370,14 @@ namespace svg
         void draw(PNGImage &img) const override;
 
     private:
-        // Fill color.
-        Color fill;
+        // Fill color or gradient.
+        Paint fill;
         // Center Point
-        Point center;
+        FixedPoint center;
         // Point with the value of the radius in the x and y axis.
-        Point radius;
+        FixedPoint radius;
+        // Rotation of the x axis of the ellipse.
+        Rotation orientation;
     };
 
     //CIRCLE SHAPE.
@@ -78,7 +388,7 @@ namespace svg
         //! @param fill Filling Color.
         //! @param center Center point of the circle.
         //! @param radius Radius (Same in x and y axis). 
-        Circle(const Point &center,const int& radius ,const Color& fill);
+        Circle(const FixedPoint &center,const fixed_value& radius ,const Color& fill);
         //! @brief Draw the circle.
         //! @param img Output PNGImage.
         void draw(PNGImage &img);
@@ -91,20 +401,50 @@ namespace svg
     public:
         //! Constructor that takes a vector of points.
         //! @param points Vector of points defining the polygon.
-        Polygon(const std::vector<Point>& points, const Color &fill);
+        Polygon(const std::vector<FixedPoint>& points, const Color &fill);
 
         //! Get all the points of the polygon.
         //! @return Vector of points.
-        std::vector<Point> get_points() const;
+        std::vector<FixedPoint> get_points() const;
+        //! Copy the points of the polygon, reusing the storage of a vector.
+        //! @param out Output points (replaced).
+        void copy_points(std::vector<FixedPoint>& out) const;
 
         //! Get the color of the polygon.
         //! @return Fill Color.
         Color get_fill() const;
-
-        //! @brief Transform SVGElement. If transform = nullpointer -> Leads to no changes made. If origin = nullpointer -> origin = (0,0).
-        //! @param transform pointer from the transform attribute.
-        //! @param origin pointer from the transform-origin attribute.
-        void transform(const char* transform, const char* origin) override;
+        //! Fill the polygon with a gradient instead of the fill color.
+        //! @param gradient Gradient, in the coordinates of the polygon.
+        void set_gradient(const std::shared_ptr<const Gradient>& gradient);
+        //! Check if the polygon is filled with a gradient rather than its color.
+        //! @return True if filled with a gradient.
+        bool has_gradient() const;
+
+        //! Check if the polygon is convex (detected on construction and after transforms).
+        //! @return True if convex polygon drawing is used.
+        bool is_convex() const;
+
+        //! Apply a parsed transform to the polygon.
+        //! @param t Transform.
+        void apply_transform(const Transform& t) override;
+        //! Bounding box of the polygon.
+        //! @return The bounding box.
+        BoundingBox get_bounds() const override;
+        //! Check if a point is inside the polygon (even-odd rule) or on its outline.
+        //! @param p Point.
+        //! @return True if inside.
+        bool contains(const FixedPoint& p) const override;
+        //! Share the points with equal polygons and polylines.
+        //! @param pool Geometry pool.
+        void share_geometry(GeometryPool& pool) override;
+        //! Check if the polygon has no points or is transparent.
+        //! @return True if empty.
+        bool empty() const override;
+        //! Check if the polygon is an opaque axis-aligned rectangle over the region.
+        //! @param region Region.
+        //! @param antialiasing True if drawn with anti-aliasing.
+        //! @return True if the region is covered.
+        bool covers(const BoundingBox& region, bool antialiasing) const override;
         //! Creates a clone of an element
         //! @return a dynamically allocated SVGElement
         SVGElement* clone() const override;
@@ -114,10 +454,17 @@ namespace svg
         void draw(PNGImage &img) const override;
 
     private:
-        // Vector with Polygon's edges.
-        std::vector<Point> points;
-        // Fill color.
-        Color fill;
+        // Polygon's vertices.
+        PointList points;
+        // Fill color or gradient.
+        Paint fill;
+        // Convex polygon (drawn with PNGImage::draw_convex_polygon).
+        bool convex;
+
+    protected:
+        //! Fill the polygon, with the convex rasterizer when possible.
+        //! @param img Output PNGImage.
+        void draw_fill(PNGImage &img) const;
     };
 
     //RECTANGLE SHAPE.
@@ -129,14 +476,14 @@ namespace svg
         //! @param width width of the rectangle.
         //! @param height height of the rectangle.
         //! @param fill rectangle color
-        Rectangle(const Point &topLeft, int width, int height, const Color &fill);
+        Rectangle(const FixedPoint &topLeft, fixed_value width, fixed_value height, const Color &fill);
 
         //! Acessor for rectangle's width.
         //! @return the width.
-        int get_width() const;
+        fixed_value get_width() const;
         //! Acessor for rectangle's height.
         //! @return The height.
-        int get_height() const;
+        fixed_value get_height() const;
 
         //! Draw the rectangle.
         //! @param img Output PNGImage.
@@ -144,9 +491,9 @@ namespace svg
 
     private:
         // Width.
-        int width;
+        fixed_value width;
         // Height.
-        int height;
+        fixed_value height;
     };
 
     class Polyline : public SVGElement {
@@ -154,19 +501,40 @@ namespace svg
             //! Constructor for the polyline object.
             //! @param points points that define the lines.
             //! @param c line color
-            Polyline(const std::vector<Point>& points, const Color &stroke);
+            Polyline(const std::vector<FixedPoint>& points, const Color &stroke);
             
             //! Acessor for the polyline's points.
             //! @return the points
-            std::vector<Point> get_points() const;
+            std::vector<FixedPoint> get_points() const;
+            //! Copy the points of the polyline, reusing the storage of a vector.
+            //! @param out Output points (replaced).
+            void copy_points(std::vector<FixedPoint>& out) const;
             //! Acessor for the Polyline color.
             //! @return the color.
             Color get_color() const;
-
-            //! @brief Transform SVGElement. If transform = nullpointer -> Leads to no changes made. If origin = nullpointer -> origin = (0,0).
-            //! @param transform pointer from the transform attribute.
-            //! @param origin pointer from the transform-origin attribute.
-            void transform(const char* transform, const char* origin) override;
+            //! Acessor for the stroke style (width, joins and caps).
+            //! @return the stroke style.
+            const StrokeStyle &get_stroke_style() const;
+            //! Set the stroke style.
+            //! @param style the stroke style.
+            void set_stroke_style(const StrokeStyle &style);
+
+            //! Apply a parsed transform to the polyline.
+            //! @param t Transform.
+            void apply_transform(const Transform& t) override;
+            //! Bounding box of the stroke.
+            //! @return The bounding box.
+            BoundingBox get_bounds() const override;
+            //! Check if a point is within half the stroke width (at least half a pixel) of a segment.
+            //! @param p Point.
+            //! @return True if on the stroke.
+            bool contains(const FixedPoint& p) const override;
+            //! Share the points with equal polygons and polylines.
+            //! @param pool Geometry pool.
+            void share_geometry(GeometryPool& pool) override;
+            //! Check if the polyline has no points or is transparent.
+            //! @return True if empty.
+            bool empty() const override;
 
             //! Creates a clone of an element.
             //! @return a dynamically allocated SVGElement.
@@ -177,10 +545,18 @@ namespace svg
             void draw(PNGImage &img) const override;
 
         private:
-            // Vector with Polyline's defining points.
-            std::vector<Point> points;
+            // Polyline's defining points.
+            PointList points;
             // Color.
             Color stroke;
+            // Stroke width, joins and caps.
+            StrokeStyle style;
+
+        protected:
+            //! Draw the points as a stroke: 1-pixel lines for the default width,
+            //! otherwise the filled stroke outline.
+            //! @param img Output PNGImage.
+            void draw_stroke(PNGImage &img) const;
     };
 
     class Line : public Polyline {
@@ -188,14 +564,76 @@ namespace svg
             //! Constructor for the Line object.
             //! @param points vector with the two points.
             //! @param c color of the line.
-            Line(const std::vector<Point>& points, const Color &c);
+            Line(const std::vector<FixedPoint>& points, const Color &c);
 
             //! Draw the line.
             //! @param img Output PNGImage.
             void draw(PNGImage &img) const override;
     };
 
-    
+    //PATH SHAPE.
+    class Path : public SVGElement {
+    public:
+        //! Constructor for the path object.
+        //! @param verbs Path segments (see parse_path_data).
+        //! @param points Points used by the segments.
+        //! @param fill Fill color.
+        //! @param rule Fill rule (fill-rule).
+        Path(const std::vector<PathVerb>& verbs, const std::vector<FixedPoint>& points, const Color &fill,
+             FillRule rule = FillRule::NonZero);
+
+        //! Acessor for the path segments.
+        //! @return the verbs.
+        const std::vector<PathVerb>& get_verbs() const;
+        //! Acessor for the path points (curve control points included).
+        //! @return the points.
+        std::vector<FixedPoint> get_points() const;
+        //! Acessor for the path color.
+        //! @return Fill Color.
+        Color get_fill() const;
+        //! Fill the path with a gradient instead of the fill color.
+        //! @param gradient Gradient, in the coordinates of the path.
+        void set_gradient(const std::shared_ptr<const Gradient>& gradient);
+        //! Acessor for the fill rule.
+        //! @return the fill rule.
+        FillRule get_fill_rule() const;
+
+        //! Apply a parsed transform to the path.
+        //! @param t Transform.
+        void apply_transform(const Transform& t) override;
+        //! Bounding box of the path points, which contains the curves.
+        //! @return The bounding box.
+        BoundingBox get_bounds() const override;
+        //! Check if a point is inside the flattened path, following the fill rule.
+        //! @param p Point.
+        //! @return True if inside.
+        bool contains(const FixedPoint& p) const override;
+        //! Share the points with equal paths, polygons and polylines.
+        //! @param pool Geometry pool.
+        void share_geometry(GeometryPool& pool) override;
+        //! Check if the path has no line or curve segment, or is transparent.
+        //! @return True if empty.
+        bool empty() const override;
+        //! Creates a clone of an element.
+        //! @return a dynamically allocated SVGElement.
+        SVGElement* clone() const override;
+
+        //! Draw the path, flattened to within PATH_TOLERANCE pixels.
+        //! @param img Output PNGImage.
+        void draw(PNGImage &img) const override;
+
+    private:
+        // Path segments.
+        std::vector<PathVerb> verbs;
+        // Points used by the segments.
+        PointList points;
+        // Fill color or gradient.
+        Paint fill;
+        // Fill rule.
+        FillRule rule;
+    };
+
+
     class Group : public SVGElement {
 
     public:
@@ -205,23 +643,87 @@ namespace svg
         //! Destructor for the group object (Prevents memory leaks).
         ~Group();
 
-        //! @brief Transform SVGElement. If transform = nullpointer -> Leads to no changes made. If origin = nullpointer -> origin = (0,0).
-        //! @param transform pointer from the transform attribute.
-        //! @param origin pointer from the transform-origin attribute.
-        void transform(const char* transform, const char* origin) override;
+        //! Apply a parsed transform to the group elements.
+        //! @param t Transform.
+        void apply_transform(const Transform& t) override;
+        //! Bounding box of the group elements.
+        //! @return The bounding box.
+        BoundingBox get_bounds() const override;
+        //! Check if a point is inside any group element.
+        //! @param p Point.
+        //! @return True if inside.
+        bool contains(const FixedPoint& p) const override;
+        //! Append the shapes of the group elements.
+        //! @param shapes Output shapes.
+        void collect_shapes(std::vector<const SVGElement*>& shapes) const override;
+        //! Share the geometry of all elements.
+        //! @param pool Geometry pool.
+        void share_geometry(GeometryPool& pool) override;
+        //! Remove (and delete) the elements that are not visible.
+        //! @param region Region.
+        //! @param min_size Minimum size.
+        void cull(const BoundingBox& region, fixed_value min_size) override;
+        //! Check if the group has no elements or is transparent.
+        //! @return True if empty.
+        bool empty() const override;
+        //! Acessor for the group elements, owned by the group; elements taken
+        //! out of it must be removed from the vector.
+        //! @return The elements, in paint order.
+        std::vector<SVGElement*>& get_elements();
+        //! Acessor for the group elements.
+        //! @return The elements, in paint order.
+        const std::vector<SVGElement*>& get_elements() const;
 
         //! Creates a clone of an element.
         //! @return a dynamically allocated SVGElement.
         SVGElement* clone() const override;
+        //! Clone the visible group elements.
+        //! @param region Region.
+        //! @param min_size Minimum size.
+        //! @return The clone, or nullptr if no element is visible.
+        SVGElement* clone_visible(const BoundingBox& region, fixed_value min_size) const override;
 
         //! Draw the group elements.
         //! @param img Output PNGImage.
         void draw(PNGImage &img) const override;
 
+    protected:
+        //! Make a group of the same kind and opacity, owning other elements.
+        //! @param elements Elements of the new group.
+        //! @return a dynamically allocated Group.
+        virtual Group* copy_with(const std::vector<SVGElement*>& elements) const;
+
     private:
         //! Vector with all the pointers to the elements inside the group.
         std::vector<SVGElement*> group_elements;
     };
+
+    //! Consecutive opaque polygons of one solid color, made by optimize_scene.
+    //! Their spans are collected and merged row by row and filled once
+    //! (PNGImage::draw_polygons), which gives the same pixels as drawing them
+    //! in turn. Hit testing and bounds still see the individual polygons.
+    class PolygonBatch : public Group {
+
+    public:
+        //! Constructor for the batch.
+        //! @param polygons Polygons (or rectangles), opaque, without gradient.
+        //! @param fill Their color.
+        PolygonBatch(const std::vector<SVGElement*>& polygons, const Color& fill);
+
+        //! Draw all the polygons in one fill.
+        //! @param img Output PNGImage.
+        void draw(PNGImage &img) const override;
+
+    protected:
+        //! Make a batch of the same color.
+        //! @param elements Polygons of the new batch.
+        //! @return a dynamically allocated PolygonBatch.
+        Group* copy_with(const std::vector<SVGElement*>& elements) const override;
+
+    private:
+        // Color of all the polygons.
+        Color fill;
+    };
     
     
 }
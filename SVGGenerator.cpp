@@ -0,0 +1,203 @@
+#include "SVGGenerator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace svg
+{
+    namespace
+    {
+        //! Small deterministic pseudo-random generator (LCG).
+        class Random
+        {
+        public:
+            Random(unsigned seed) : state(seed * 2654435761u + 1) {}
+            //! @return Integer in [lo, hi].
+            int next(int lo, int hi)
+            {
+                state = state * 1664525u + 1013904223u;
+                if (hi <= lo)
+                {
+                    return lo;
+                }
+                return lo + (int)((state >> 8) % (unsigned)(hi - lo + 1));
+            }
+
+        private:
+            unsigned state;
+        };
+
+        void write_fill(Random &rnd, int opacity, std::ostream &out)
+        {
+            static const char *HEX = "0123456789ABCDEF";
+            out << '#';
+            for (int i = 0; i < 6; i++)
+            {
+                out << HEX[rnd.next(0, 15)];
+            }
+            out << '"';
+            if (opacity < 100)
+            {
+                out << " fill-opacity=\"" << opacity / 100.0 << '"';
+            }
+        }
+
+        //! Write a star-shaped (hence simple) polygon inside the box [x0,x1]x[y0,y1],
+        //! and its copies at other random positions in the box.
+        void write_polygon(Random &rnd, int vertices, int copies, int opacity, int x0, int y0, int x1, int y1,
+                           std::ostream &out)
+        {
+            int max_r = std::max(1, std::min(std::min(x1 - x0, y1 - y0) / 2, 60));
+            int r_out = rnd.next(std::max(1, max_r / 4), max_r);
+            int cx = rnd.next(x0 + r_out, x1 - r_out);
+            int cy = rnd.next(y0 + r_out, y1 - r_out);
+            std::vector<int> dx, dy;
+            for (int i = 0; i < vertices; i++)
+            {
+                double angle = 2 * M_PI * i / vertices;
+                int r = rnd.next(r_out / 2, r_out);
+                dx.push_back((int)::lround(r * ::cos(angle)));
+                dy.push_back((int)::lround(r * ::sin(angle)));
+            }
+            std::ostringstream fill;
+            write_fill(rnd, opacity, fill);
+            for (int c = 0; c < copies; c++)
+            {
+                if (c > 0)
+                {
+                    cx = rnd.next(x0 + r_out, x1 - r_out);
+                    cy = rnd.next(y0 + r_out, y1 - r_out);
+                }
+                out << "    <polygon points=\"";
+                for (int i = 0; i < vertices; i++)
+                {
+                    out << (i > 0 ? " " : "") << cx + dx[i] << ',' << cy + dy[i];
+                }
+                out << "\" fill=\"" << fill.str() << "/>\n";
+            }
+        }
+
+        void write_circle(Random &rnd, int opacity, int x0, int y0, int x1, int y1, std::ostream &out)
+        {
+            int max_r = std::max(1, std::min(std::min(x1 - x0, y1 - y0) / 2, 50));
+            int r = rnd.next(1, max_r);
+            out << "    <circle cx=\"" << rnd.next(x0 + r, x1 - r)
+                << "\" cy=\"" << rnd.next(y0 + r, y1 - r)
+                << "\" r=\"" << r << "\" fill=\"";
+            write_fill(rnd, opacity, out);
+            out << "/>\n";
+        }
+    }
+
+    SynthParams parse_synth_params(const std::string &spec)
+    {
+        SynthParams p;
+        std::istringstream iss(spec);
+        std::string item;
+        while (std::getline(iss, item, ','))
+        {
+            if (item.empty())
+            {
+                continue;
+            }
+            size_t eq = item.find('=');
+            if (eq == std::string::npos)
+            {
+                throw std::runtime_error("Invalid generator parameter: " + item);
+            }
+            std::string key = item.substr(0, eq);
+            int value = std::atoi(item.c_str() + eq + 1);
+            if (key == "width") p.width = value;
+            else if (key == "height") p.height = value;
+            else if (key == "polygons") p.polygons = value;
+            else if (key == "vertices") p.vertices = value;
+            else if (key == "copies") p.copies = value;
+            else if (key == "circles") p.circles = value;
+            else if (key == "depth") p.depth = value;
+            else if (key == "uses") p.uses = value;
+            else if (key == "opacity") p.opacity = value;
+            else if (key == "seed") p.seed = (unsigned)value;
+            else throw std::runtime_error("Unknown generator parameter: " + key);
+        }
+        if (p.width < 8 || p.height < 8 || p.vertices < 3 || p.copies < 1 || p.opacity < 0 || p.opacity > 100)
+        {
+            throw std::runtime_error("Invalid generator parameters: " + spec);
+        }
+        return p;
+    }
+
+    std::string synth_name(const SynthParams &p)
+    {
+        std::ostringstream oss;
+        oss << 'p' << p.polygons << 'x' << p.vertices
+            << "_c" << p.circles
+            << "_d" << p.depth
+            << "_u" << p.uses
+            << '_' << p.width << 'x' << p.height;
+        if (p.opacity < 100)
+        {
+            oss << "_o" << p.opacity;
+        }
+        if (p.copies > 1)
+        {
+            oss << "_k" << p.copies;
+        }
+        return oss.str();
+    }
+
+    void generate_svg(const SynthParams &p, std::ostream &out)
+    {
+        Random rnd(p.seed);
+        out << "<svg width=\"" << p.width << "\" height=\"" << p.height
+            << "\" xmlns=\"http://www.w3.org/2000/svg\">\n";
+
+        // Shared tile referenced by <use>, kept in the top-left quarter of the
+        // canvas so that any translation by up to half the canvas stays inside.
+        int tile_w = p.width / 2, tile_h = p.height / 2;
+        if (p.uses > 0)
+        {
+            out << "  <g id=\"tile\">\n";
+            write_circle(rnd, p.opacity, 0, 0, tile_w - 1, tile_h - 1, out);
+            write_polygon(rnd, p.vertices, 1, p.opacity, 0, 0, tile_w - 1, tile_h - 1, out);
+            out << "  </g>\n";
+        }
+
+        // Nested groups; each level translates by one pixel, so the innermost
+        // content is drawn in a box shrunk by the nesting depth.
+        int margin = std::min(p.depth, std::min(p.width, p.height) / 4);
+        for (int d = 0; d < p.depth; d++)
+        {
+            out << "  <g transform=\"translate(" << (d < margin ? 1 : 0) << ' ' << (d < margin ? 1 : 0) << ")\">\n";
+        }
+        int x1 = p.width - 1 - margin, y1 = p.height - 1 - margin;
+        for (int i = 0, j = 0; i < p.polygons || j < p.circles;)
+        {
+            if (i < p.polygons)
+            {
+                write_polygon(rnd, p.vertices, p.copies, p.opacity, 0, 0, x1, y1, out);
+                i++;
+            }
+            if (j < p.circles)
+            {
+                write_circle(rnd, p.opacity, 0, 0, x1, y1, out);
+                j++;
+            }
+        }
+        for (int d = 0; d < p.depth; d++)
+        {
+            out << "  </g>\n";
+        }
+
+        for (int i = 0; i < p.uses; i++)
+        {
+            out << "  <use href=\"#tile\" transform=\"translate("
+                << rnd.next(0, p.width - tile_w) << ' '
+                << rnd.next(0, p.height - tile_h) << ")\"/>\n";
+        }
+        out << "</svg>\n";
+    }
+}
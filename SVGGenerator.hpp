@@ -0,0 +1,55 @@
+//! @file SVGGenerator.hpp
+#ifndef __svg_SVGGenerator_hpp__
+#define __svg_SVGGenerator_hpp__
+
+#include <ostream>
+#include <string>
+
+namespace svg
+{
+    //! Parameters for a synthetic SVG document.
+    //! All generated geometry stays inside the canvas.
+    struct SynthParams
+    {
+        //! Canvas width.
+        int width = 800;
+        //! Canvas height.
+        int height = 600;
+        //! Number of polygons.
+        int polygons = 0;
+        //! Number of vertices per polygon.
+        int vertices = 3;
+        //! Number of copies of each polygon, written out at other positions
+        //! (as exported without <use>).
+        int copies = 1;
+        //! Number of circles.
+        int circles = 0;
+        //! Group nesting depth around the polygons and circles.
+        int depth = 0;
+        //! Number of <use> references to a shared group.
+        int uses = 0;
+        //! Fill opacity of the shapes, in percent.
+        int opacity = 100;
+        //! Seed for the pseudo-random generator.
+        unsigned seed = 1;
+    };
+
+    //! Parse generator parameters from a "key=value,key=value" string.
+    //! Keys: width, height, polygons, vertices, copies, circles, depth, uses, opacity, seed.
+    //! @param spec Parameter string.
+    //! @return Parsed parameters (unspecified keys keep their defaults).
+    SynthParams parse_synth_params(const std::string &spec);
+
+    //! Get a short name describing the parameters, usable as a file name.
+    //! @param p Parameters.
+    //! @return Name such as "p1000x3_c0_d0_u0_800x600" (with an "_o50" suffix for
+    //! opacity 50%, and "_k4" for 4 copies).
+    std::string synth_name(const SynthParams &p);
+
+    //! Write a synthetic SVG document.
+    //! The output is deterministic for a given set of parameters.
+    //! @param p Parameters.
+    //! @param out Output stream.
+    void generate_svg(const SynthParams &p, std::ostream &out);
+}
+#endif
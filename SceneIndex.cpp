@@ -0,0 +1,149 @@
+#include "SceneIndex.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace svg
+{
+    SceneIndex::SceneIndex(const std::vector<SVGElement *> &elements)
+        : extent_(BoundingBox::empty()), cols_(0), rows_(0), cell_w_(1), cell_h_(1)
+    {
+        TRACE_SCOPE("SceneIndex", "index");
+        for (const SVGElement *e : elements)
+        {
+            e->collect_shapes(shapes_);
+        }
+        bounds_.reserve(shapes_.size());
+        for (const SVGElement *shape : shapes_)
+        {
+            bounds_.push_back(shape->get_bounds());
+            extent_.add(hit_box(bounds_.size() - 1));
+        }
+        if (extent_.is_empty())
+        {
+            return;
+        }
+        // About one shape per cell for evenly spread scenes.
+        int side = std::max(1, std::min(256, (int)std::ceil(std::sqrt((double)shapes_.size()))));
+        cols_ = rows_ = side;
+        cell_w_ = std::max<fixed_value>(1, (extent_.x1 - extent_.x0) / side + 1);
+        cell_h_ = std::max<fixed_value>(1, (extent_.y1 - extent_.y0) / side + 1);
+
+        // Two passes (count, then fill) into one flat array; shapes are added
+        // in paint order, so every cell list is sorted.
+        cell_starts_.assign((size_t)cols_ * rows_ + 1, 0);
+        int c0, r0, c1, r1;
+        for (size_t i = 0; i < bounds_.size(); i++)
+        {
+            if (!cell_range(hit_box(i), c0, r0, c1, r1))
+            {
+                continue;
+            }
+            for (int r = r0; r <= r1; r++)
+            {
+                for (int c = c0; c <= c1; c++)
+                {
+                    cell_starts_[r * cols_ + c + 1]++;
+                }
+            }
+        }
+        for (size_t i = 1; i < cell_starts_.size(); i++)
+        {
+            cell_starts_[i] += cell_starts_[i - 1];
+        }
+        cell_items_.resize(cell_starts_.back());
+        std::vector<size_t> fill(cell_starts_.begin(), cell_starts_.end() - 1);
+        for (size_t i = 0; i < bounds_.size(); i++)
+        {
+            if (!cell_range(hit_box(i), c0, r0, c1, r1))
+            {
+                continue;
+            }
+            for (int r = r0; r <= r1; r++)
+            {
+                for (int c = c0; c <= c1; c++)
+                {
+                    cell_items_[fill[r * cols_ + c]++] = (unsigned)i;
+                }
+            }
+        }
+    }
+
+    size_t SceneIndex::size() const
+    {
+        return shapes_.size();
+    }
+
+    BoundingBox SceneIndex::hit_box(size_t item) const
+    {
+        return bounds_[item].expand(SVGElement::HIT_MARGIN);
+    }
+
+    bool SceneIndex::cell_range(const BoundingBox &box, int &c0, int &r0, int &c1, int &r1) const
+    {
+        if (!box.intersects(extent_))
+        {
+            return false;
+        }
+        c0 = std::max(0, (box.x0 - extent_.x0) / cell_w_);
+        r0 = std::max(0, (box.y0 - extent_.y0) / cell_h_);
+        c1 = std::min(cols_ - 1, (box.x1 - extent_.x0) / cell_w_);
+        r1 = std::min(rows_ - 1, (box.y1 - extent_.y0) / cell_h_);
+        return true;
+    }
+
+    const SVGElement *SceneIndex::element_at(const FixedPoint &p) const
+    {
+        int c, r, c1, r1;
+        if (!cell_range({p.x, p.y, p.x, p.y}, c, r, c1, r1))
+        {
+            return nullptr;
+        }
+        size_t cell = (size_t)r * cols_ + c;
+        // Topmost first.
+        for (size_t i = cell_starts_[cell + 1]; i-- > cell_starts_[cell];)
+        {
+            unsigned item = cell_items_[i];
+            BoundingBox box = hit_box(item);
+            if (p.x >= box.x0 && p.x <= box.x1 && p.y >= box.y0 && p.y <= box.y1 &&
+                shapes_[item]->contains(p))
+            {
+                return shapes_[item];
+            }
+        }
+        return nullptr;
+    }
+
+    void SceneIndex::query(const BoundingBox &rect, std::vector<const SVGElement *> &out) const
+    {
+        out.clear();
+        int c0, r0, c1, r1;
+        if (!cell_range(rect, c0, r0, c1, r1))
+        {
+            return;
+        }
+        std::vector<unsigned> items;
+        for (int r = r0; r <= r1; r++)
+        {
+            for (int c = c0; c <= c1; c++)
+            {
+                size_t cell = (size_t)r * cols_ + c;
+                for (size_t i = cell_starts_[cell]; i < cell_starts_[cell + 1]; i++)
+                {
+                    if (bounds_[cell_items_[i]].intersects(rect))
+                    {
+                        items.push_back(cell_items_[i]);
+                    }
+                }
+            }
+        }
+        // Shapes spanning several cells are found once per cell.
+        std::sort(items.begin(), items.end());
+        items.erase(std::unique(items.begin(), items.end()), items.end());
+        for (unsigned item : items)
+        {
+            out.push_back(shapes_[item]);
+        }
+    }
+}
@@ -0,0 +1,56 @@
+//! @file SceneIndex.hpp
+#ifndef __svg_SceneIndex_hpp__
+#define __svg_SceneIndex_hpp__
+
+#include "SVGElements.hpp"
+
+#include <vector>
+
+namespace svg
+{
+    //! Spatial index over the shapes of a scene, for hit testing.
+    //! Shapes (group members included) are kept in paint order and bucketed
+    //! by bounding box into a uniform grid covering the scene, so queries only
+    //! look at the shapes of the cells they touch. The index refers to the
+    //! elements, which must outlive it and not be transformed meanwhile.
+    class SceneIndex
+    {
+    public:
+        //! Build the index, e.g. right after readSVG.
+        //! @param elements Scene elements, in paint order.
+        SceneIndex(const std::vector<SVGElement *> &elements);
+
+        //! Number of indexed shapes.
+        //! @return The number of shapes.
+        size_t size() const;
+        //! Topmost shape containing a point (see SVGElement::contains).
+        //! @param p Point.
+        //! @return The shape painted last among those containing p, or nullptr.
+        const SVGElement *element_at(const FixedPoint &p) const;
+        //! Shapes whose bounding box intersects a rectangle.
+        //! @param rect Rectangle.
+        //! @param out Output shapes, in paint order (cleared first).
+        void query(const BoundingBox &rect, std::vector<const SVGElement *> &out) const;
+
+    private:
+        //! Cell range [c0, c1] x [r0, r1] covering a box, clamped to the grid.
+        //! @return False if the box misses the grid.
+        bool cell_range(const BoundingBox &box, int &c0, int &r0, int &c1, int &r1) const;
+
+        //! Hit box of a shape: its bounds grown by SVGElement::HIT_MARGIN.
+        BoundingBox hit_box(size_t item) const;
+
+        //! Shapes in paint order, with their bounding boxes.
+        std::vector<const SVGElement *> shapes_;
+        std::vector<BoundingBox> bounds_;
+        //! Grid covering the union of the hit boxes.
+        BoundingBox extent_;
+        int cols_, rows_;
+        fixed_value cell_w_, cell_h_;
+        //! Shape indices of each cell (row-major), in increasing paint order:
+        //! cell i holds cell_items_[cell_starts_[i] .. cell_starts_[i + 1]).
+        std::vector<size_t> cell_starts_;
+        std::vector<unsigned> cell_items_;
+    };
+}
+#endif
@@ -0,0 +1,180 @@
+#include "Stroke.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+namespace svg
+{
+    namespace
+    {
+        //! Finish the contour written last, reversing it if needed so that all
+        //! contours turn the same way, or dropping it if it has no area.
+        void close_contour(ContourWriter &out)
+        {
+            Contour &contour = out.last();
+            double area = 0;
+            for (size_t i = 0; i < contour.size(); i++)
+            {
+                const Vertex &a = contour[i];
+                const Vertex &b = contour[(i + 1) % contour.size()];
+                area += a.x * b.y - b.x * a.y;
+            }
+            if (area < 0)
+            {
+                std::reverse(contour.begin(), contour.end());
+            }
+            if (area == 0)
+            {
+                out.drop_last();
+            }
+        }
+
+        //! Append a contour (see close_contour).
+        void add_contour(std::initializer_list<Vertex> vertices, ContourWriter &out)
+        {
+            out.add().assign(vertices);
+            close_contour(out);
+        }
+
+        //! Append a circle, flattened to within 1/16 pixel.
+        void add_circle(const Vertex &center, double r, ContourWriter &out)
+        {
+            int n = (int)std::ceil(M_PI / std::acos(1 - std::min(1.0, 0.0625 / std::max(r, 0.0625))));
+            n = std::max(8, std::min(n, 1024));
+            Contour &circle = out.add();
+            circle.resize(n);
+            for (int i = 0; i < n; i++)
+            {
+                double angle = 2 * M_PI * i / n;
+                circle[i] = {center.x + r * std::cos(angle), center.y + r * std::sin(angle)};
+            }
+            close_contour(out);
+        }
+    }
+
+    LineJoin parse_line_join(const char *str)
+    {
+        if (str != nullptr && std::strcmp(str, "round") == 0)
+            return LineJoin::Round;
+        if (str != nullptr && std::strcmp(str, "bevel") == 0)
+            return LineJoin::Bevel;
+        return LineJoin::Miter;
+    }
+
+    LineCap parse_line_cap(const char *str)
+    {
+        if (str != nullptr && std::strcmp(str, "round") == 0)
+            return LineCap::Round;
+        if (str != nullptr && std::strcmp(str, "square") == 0)
+            return LineCap::Square;
+        return LineCap::Butt;
+    }
+
+    void stroke_outline(const std::vector<FixedPoint> &points, const StrokeStyle &style,
+                        std::vector<Contour> &contours)
+    {
+        ContourWriter out(contours);
+        double hw = style.width / 2;
+        if (hw <= 0 || points.empty())
+        {
+            return;
+        }
+        // Polyline without zero-length segments, and the unit direction of each segment.
+        thread_local std::vector<Vertex> pts;
+        thread_local std::vector<Vertex> dirs;
+        pts.clear();
+        dirs.clear();
+        pts.push_back(points[0].vertex());
+        for (size_t i = 1; i < points.size(); i++)
+        {
+            Vertex p = points[i].vertex();
+            double dx = p.x - pts.back().x, dy = p.y - pts.back().y;
+            double len = std::sqrt(dx * dx + dy * dy);
+            if (len > 0)
+            {
+                dirs.push_back({dx / len, dy / len});
+                pts.push_back(p);
+            }
+        }
+
+        if (dirs.empty())
+        {
+            // Degenerate stroke: only round and square caps paint something.
+            const Vertex &p = pts[0];
+            if (style.cap == LineCap::Round)
+            {
+                add_circle(p, hw, out);
+            }
+            else if (style.cap == LineCap::Square)
+            {
+                add_contour({{p.x - hw, p.y - hw}, {p.x + hw, p.y - hw}, {p.x + hw, p.y + hw}, {p.x - hw, p.y + hw}}, out);
+            }
+            return;
+        }
+
+        // Segment bodies.
+        for (size_t i = 0; i < dirs.size(); i++)
+        {
+            Vertex a = pts[i], b = pts[i + 1];
+            const Vertex &d = dirs[i];
+            if (style.cap == LineCap::Square)
+            {
+                if (i == 0)
+                {
+                    a = {a.x - d.x * hw, a.y - d.y * hw};
+                }
+                if (i + 1 == dirs.size())
+                {
+                    b = {b.x + d.x * hw, b.y + d.y * hw};
+                }
+            }
+            Vertex n = {-d.y * hw, d.x * hw};
+            add_contour({{a.x + n.x, a.y + n.y}, {b.x + n.x, b.y + n.y}, {b.x - n.x, b.y - n.y}, {a.x - n.x, a.y - n.y}}, out);
+        }
+
+        // Joins.
+        for (size_t i = 1; i < dirs.size(); i++)
+        {
+            const Vertex &v = pts[i];
+            const Vertex &d1 = dirs[i - 1], &d2 = dirs[i];
+            double cross = d1.x * d2.y - d1.y * d2.x;
+            double dot = d1.x * d2.x + d1.y * d2.y;
+            if (std::fabs(cross) < 1e-12 && dot > 0)
+            {
+                continue;
+            }
+            if (style.join == LineJoin::Round)
+            {
+                add_circle(v, hw, out);
+                continue;
+            }
+            // Outer side of the turn.
+            double s = cross > 0 ? -1 : 1;
+            Vertex p1 = {v.x - s * d1.y * hw, v.y + s * d1.x * hw};
+            Vertex p2 = {v.x - s * d2.y * hw, v.y + s * d2.x * hw};
+            // Miter length relative to the stroke width is 1 / cos(turn / 2).
+            double cos_half = std::sqrt(std::max(0.0, (1 + dot) / 2));
+            if (style.join == LineJoin::Miter && cos_half > 0 && 1 / cos_half <= style.miter_limit)
+            {
+                double mx = (p1.x + p2.x) / 2 - v.x, my = (p1.y + p2.y) / 2 - v.y;
+                double m_len = std::sqrt(mx * mx + my * my);
+                double tip_len = hw / cos_half;
+                Vertex tip = {v.x + mx / m_len * tip_len, v.y + my / m_len * tip_len};
+                add_contour({v, p1, tip, p2}, out);
+            }
+            else
+            {
+                add_contour({v, p1, p2}, out);
+            }
+        }
+
+        // Round caps.
+        if (style.cap == LineCap::Round)
+        {
+            add_circle(pts.front(), hw, out);
+            add_circle(pts.back(), hw, out);
+        }
+    }
+}
@@ -0,0 +1,65 @@
+//! @file Stroke.hpp
+#ifndef __svg_Stroke_hpp__
+#define __svg_Stroke_hpp__
+
+#include "PNGImage.hpp"
+#include "Point.hpp"
+
+#include <string>
+#include <vector>
+
+namespace svg
+{
+    //! Shape used where two stroke segments meet (stroke-linejoin).
+    enum class LineJoin
+    {
+        Miter,
+        Round,
+        Bevel
+    };
+
+    //! Shape used at the ends of an open stroke (stroke-linecap).
+    enum class LineCap
+    {
+        Butt,
+        Round,
+        Square
+    };
+
+    //! Stroke geometry attributes.
+    struct StrokeStyle
+    {
+        //! Stroke width (stroke-width), scaled with the shape.
+        double width = 1.0;
+        //! Default line without stroke-width: a 1-pixel line joining the
+        //! pixels nearest to its points, whose width document transforms do
+        //! not change (views that magnify it turn it into a stroke).
+        bool hairline = true;
+        //! Line join (stroke-linejoin).
+        LineJoin join = LineJoin::Miter;
+        //! Line cap (stroke-linecap).
+        LineCap cap = LineCap::Butt;
+        //! Miter limit (stroke-miterlimit), as a ratio of miter length to width.
+        double miter_limit = 4.0;
+    };
+
+    //! Parse a stroke-linejoin value ("miter", "round" or "bevel").
+    //! @param str Attribute value (nullptr for the default).
+    //! @return The line join, Miter if unknown.
+    LineJoin parse_line_join(const char *str);
+    //! Parse a stroke-linecap value ("butt", "round" or "square").
+    //! @param str Attribute value (nullptr for the default).
+    //! @return The line cap, Butt if unknown.
+    LineCap parse_line_cap(const char *str);
+
+    //! Build the outline of a stroked polyline.
+    //! The outline is made of one quad per segment plus join and cap shapes,
+    //! all oriented the same way, so that their union is obtained by filling
+    //! them together with the nonzero rule (each pixel is painted once).
+    //! @param points Polyline points.
+    //! @param style Stroke style.
+    //! @param contours Output contours, replaced (their storage is reused, see ContourWriter).
+    void stroke_outline(const std::vector<FixedPoint> &points, const StrokeStyle &style,
+                        std::vector<Contour> &contours);
+}
+#endif
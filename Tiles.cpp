@@ -0,0 +1,224 @@
+#include "SVGElements.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+namespace svg
+{
+    namespace
+    {
+        //! Scene geometry at one zoom level.
+        struct Level
+        {
+            //! Size in pixels.
+            int width, height;
+            //! Number of tile columns and rows.
+            int cols, rows;
+            //! Elements, in level pixel coordinates.
+            std::vector<SVGElement *> elements;
+        };
+
+        //! One tile to render.
+        struct TileJob
+        {
+            int zoom, x, y;
+        };
+
+        //! Create a directory if it does not exist.
+        void make_dir(const std::string &path)
+        {
+            if (::mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+            {
+                throw std::runtime_error("Unable to create directory " + path);
+            }
+        }
+
+        //! Render tile (job.x, job.y) of a level directly from its geometry.
+        void render_tile(const Level &level, const TileJob &job, const TileOptions &options,
+                         const std::string &png_file)
+        {
+            TRACE_SCOPE("tile", "tiles");
+            int x0 = job.x * options.tile_size, y0 = job.y * options.tile_size;
+            int w = std::min(options.tile_size, level.width - x0);
+            int h = std::min(options.tile_size, level.height - y0);
+            PNGImage img(w, h);
+            img.set_antialiasing(options.render.antialiasing);
+            BoundingBox tile = {to_fixed(x0), to_fixed(y0), to_fixed(x0 + w - 1), to_fixed(y0 + h - 1)};
+            fixed_value min_size = to_fixed(options.render.min_size);
+            // Whole-pixel shift, so tiles of the full-size level are exact crops.
+            // It only moves the offsets of the point lists, which the clones
+            // share with the level.
+            Transform shift = Transform::view({to_fixed(x0), to_fixed(y0)}, 1.0);
+            for (const SVGElement *e : level.elements)
+            {
+                // Culled before copying, so a group spanning the document
+                // only has its members meeting the tile copied.
+                SVGElement *copy = e->clone_visible(tile, min_size);
+                if (copy == nullptr)
+                {
+                    continue;
+                }
+                copy->apply_transform(shift);
+                copy->draw(img);
+                delete copy;
+            }
+            img.save(png_file);
+        }
+
+        //! Render the tiles of all levels into out_dir/z/x/y.png on a pool of
+        //! threads. Each job catches its own error; once one has failed, the
+        //! remaining jobs are skipped and the first error, in job order, is
+        //! rethrown after all threads have joined.
+        //! @return Number of tiles written.
+        int render_levels(const std::vector<Level> &levels, const std::string &out_dir, const TileOptions &options)
+        {
+            // Directories are created up front; the largest levels come first
+            // so that the workers finish together.
+            make_dir(out_dir);
+            std::vector<TileJob> jobs;
+            for (int z = (int)levels.size() - 1; z >= 0; z--)
+            {
+                make_dir(out_dir + "/" + std::to_string(z));
+                for (int x = 0; x < levels[z].cols; x++)
+                {
+                    make_dir(out_dir + "/" + std::to_string(z) + "/" + std::to_string(x));
+                    for (int y = 0; y < levels[z].rows; y++)
+                    {
+                        jobs.push_back({z, x, y});
+                    }
+                }
+            }
+
+            std::vector<std::exception_ptr> errors(jobs.size());
+            std::atomic<bool> failed(false);
+            std::atomic<size_t> next_job(0);
+            auto worker = [&]()
+            {
+                for (size_t i = next_job++; i < jobs.size() && !failed; i = next_job++)
+                {
+                    const TileJob &job = jobs[i];
+                    try
+                    {
+                        render_tile(levels[job.zoom], job, options,
+                                    out_dir + "/" + std::to_string(job.zoom) + "/" + std::to_string(job.x) +
+                                        "/" + std::to_string(job.y) + ".png");
+                    }
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
+                        failed = true;
+                    }
+                }
+            };
+            int n_threads = options.jobs > 0 ? options.jobs : (int)std::thread::hardware_concurrency();
+            n_threads = std::max(1, std::min(n_threads, (int)jobs.size()));
+            std::vector<std::thread> threads;
+            for (int t = 1; t < n_threads; t++)
+            {
+                threads.emplace_back(worker);
+            }
+            worker();
+            for (std::thread &t : threads)
+            {
+                t.join();
+            }
+            for (const std::exception_ptr &error : errors)
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
+            return (int)jobs.size();
+        }
+    }
+
+    int render_tiles(const std::string &svg_file, const std::string &out_dir, const TileOptions &options)
+    {
+        trace::Session session;
+        int count = 0;
+        {
+            TRACE_SCOPE("render_tiles", "tiles");
+            if (options.tile_size <= 0)
+            {
+                throw std::invalid_argument("Tile size must be positive");
+            }
+            Point dimensions;
+            std::vector<SVGElement *> svg_elements;
+            readSVG(svg_file, dimensions, svg_elements, options.render.jobs);
+            if (options.render.share_geometry)
+            {
+                // Tile clones share the storage too, until scaled.
+                share_geometry(svg_elements);
+            }
+
+            // Level max_zoom is the document at full size; each level below
+            // halves it, down to level 0 which fits in a single tile.
+            int max_zoom = 0;
+            while ((long long)options.tile_size << max_zoom < std::max(dimensions.x, dimensions.y))
+            {
+                max_zoom++;
+            }
+            std::vector<Level> levels(max_zoom + 1);
+            levels[max_zoom].elements = svg_elements;
+            // The levels are freed before any error is rethrown.
+            std::exception_ptr error;
+            try
+            {
+                {
+                    TRACE_SCOPE("levels", "tiles");
+                    for (int z = 0; z <= max_zoom; z++)
+                    {
+                        double scale = std::ldexp(1.0, z - max_zoom);
+                        Level &level = levels[z];
+                        level.width = std::max(1, (int)std::ceil(dimensions.x * scale));
+                        level.height = std::max(1, (int)std::ceil(dimensions.y * scale));
+                        level.cols = (level.width + options.tile_size - 1) / options.tile_size;
+                        level.rows = (level.height + options.tile_size - 1) / options.tile_size;
+                        if (z == max_zoom)
+                        {
+                            continue;
+                        }
+                        Transform view = Transform::view({0, 0}, scale);
+                        for (const SVGElement *e : svg_elements)
+                        {
+                            SVGElement *copy = e->clone();
+                            level.elements.push_back(copy);
+                            copy->apply_transform(view);
+                        }
+                    }
+                }
+                count = render_levels(levels, out_dir, options);
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+
+            TRACE_SCOPE("cleanup", "tiles");
+            for (Level &level : levels)
+            {
+                for (SVGElement *e : level.elements)
+                {
+                    delete e;
+                }
+            }
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+        return count;
+    }
+}
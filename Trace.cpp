@@ -0,0 +1,106 @@
+#include "Trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+namespace svg
+{
+    namespace trace
+    {
+        std::atomic<bool> active(false);
+
+        namespace
+        {
+            struct Event
+            {
+                const char *name;
+                const char *category;
+                double begin_us;
+                double end_us;
+                size_t tid;
+            };
+
+            std::mutex events_mutex;
+            std::vector<Event> events;
+            std::string output_file;
+            std::once_flag env_once;
+            //! Sessions running (see Session).
+            std::atomic<int> sessions(0);
+            //! Next thread id of the trace (threads are numbered as they record).
+            std::atomic<size_t> next_tid(1);
+            const std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+        }
+
+        void start(const std::string &trace_file)
+        {
+            std::lock_guard<std::mutex> lock(events_mutex);
+            output_file = trace_file;
+            active = true;
+        }
+
+        void start_from_env()
+        {
+            std::call_once(env_once, []()
+                           {
+                               const char *file = std::getenv("SVG_TRACE");
+                               // An explicit start() takes precedence.
+                               if (file != nullptr && *file != '\0' && !active)
+                               {
+                                   start(file);
+                               } });
+        }
+
+        Session::Session()
+        {
+            start_from_env();
+            sessions++;
+        }
+
+        Session::~Session()
+        {
+            if (--sessions == 0)
+            {
+                flush();
+            }
+        }
+
+        double now_us()
+        {
+            return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+        }
+
+        void record(const char *name, const char *category, double begin_us, double end_us)
+        {
+            thread_local size_t tid = next_tid++;
+            std::lock_guard<std::mutex> lock(events_mutex);
+            events.push_back({name, category, begin_us, end_us, tid});
+        }
+
+        void flush()
+        {
+            if (!active)
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(events_mutex);
+            FILE *out = std::fopen(output_file.c_str(), "w");
+            if (out == nullptr)
+            {
+                std::perror(("Unable to write trace file " + output_file).c_str());
+                return;
+            }
+            std::fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+            for (size_t i = 0; i < events.size(); i++)
+            {
+                const Event &e = events[i];
+                std::fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%zu}",
+                             i > 0 ? "," : "", e.name, e.category, e.begin_us, e.end_us - e.begin_us, e.tid);
+            }
+            std::fprintf(out, "\n]}\n");
+            std::fclose(out);
+        }
+    }
+}
@@ -0,0 +1,103 @@
+//! @file Trace.hpp
+#ifndef __svg_Trace_hpp__
+#define __svg_Trace_hpp__
+
+#include "Alloc.hpp"
+
+#include <atomic>
+#include <string>
+
+namespace svg
+{
+    //! Scoped trace points, written as a Chrome/Perfetto trace-event JSON file.
+    //! Tracing is enabled by setting the SVG_TRACE environment variable to the
+    //! output file name, or by calling trace::start(). A trace point also names
+    //! the allocation site of its scope for allocation profiling (Alloc.hpp).
+    //! When both are disabled, a trace point costs a test of two global flags.
+    namespace trace
+    {
+        //! True while tracing is enabled (use enabled() to read it).
+        extern std::atomic<bool> active;
+
+        //! Check whether tracing is enabled.
+        //! @return True if trace points are being recorded.
+        inline bool enabled() { return active.load(std::memory_order_relaxed); }
+
+        //! Enable tracing.
+        //! @param trace_file Output JSON file, written by flush().
+        void start(const std::string &trace_file);
+        //! Enable tracing if the SVG_TRACE environment variable is set.
+        //! Only the first call has any effect, even if calls are concurrent.
+        void start_from_env();
+        //! Write all events recorded so far to the trace file.
+        void flush();
+
+        //! Top-level traced call (e.g. convert or convert_batch): the first
+        //! session checks SVG_TRACE, and the trace file is written when the
+        //! last running session ends, so concurrent and nested calls write it
+        //! once, with the events of all of them.
+        class Session
+        {
+        public:
+            Session();
+            ~Session();
+
+        private:
+            Session(const Session &) = delete;
+            Session &operator=(const Session &) = delete;
+        };
+
+        //! Record a complete event.
+        //! @param name Event name (must outlive the trace, e.g. a string literal).
+        //! @param category Event category (same lifetime requirement).
+        //! @param begin_us Start time in microseconds (see now_us()).
+        //! @param end_us End time in microseconds.
+        void record(const char *name, const char *category, double begin_us, double end_us);
+        //! Get the current time in microseconds since tracing started.
+        double now_us();
+
+        //! Trace point covering the lifetime of the object.
+        class Scope
+        {
+        public:
+            Scope(const char *name, const char *category)
+                : name(enabled() ? name : nullptr), category(category), begin_us(0),
+                  site_set(alloc::enabled()), previous_site(site_set ? alloc::exchange_site(name) : nullptr)
+            {
+                if (this->name != nullptr)
+                {
+                    begin_us = now_us();
+                }
+            }
+            ~Scope()
+            {
+                if (name != nullptr)
+                {
+                    record(name, category, begin_us, now_us());
+                }
+                if (site_set)
+                {
+                    alloc::exchange_site(previous_site);
+                }
+            }
+
+        private:
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+            const char *name;
+            const char *category;
+            double begin_us;
+            // Allocation site replaced by this scope, if profiling allocations.
+            bool site_set;
+            const char *previous_site;
+        };
+    }
+}
+
+#define SVG_TRACE_CONCAT_(a, b) a##b
+#define SVG_TRACE_CONCAT(a, b) SVG_TRACE_CONCAT_(a, b)
+//! Trace the enclosing scope with the given name and category literals.
+#define TRACE_SCOPE(name, category) \
+    ::svg::trace::Scope SVG_TRACE_CONCAT(trace_scope_, __LINE__)(name, category)
+
+#endif
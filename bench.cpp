@@ -0,0 +1,525 @@
+// Project file headers
+#include "Alloc.hpp"
+#include "PerfCounters.hpp"
+#include "RenderContext.hpp"
+#include "SVGElements.hpp"
+#include "SVGGenerator.hpp"
+#include "Trace.hpp"
+#include "external/tinyxml2/tinyxml2.h"
+
+// C++ library headers
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+// POSIX headers
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace svg
+{
+    const string BENCH_OUTPUT_FILE = "bench_output.txt";
+
+    //! Synthetic cases run by default (see SynthParams).
+    const char *DEFAULT_SYNTH_CASES[] = {
+        "polygons=2000,vertices=3",
+        "polygons=200,vertices=64",
+        "polygons=200,vertices=64,opacity=50",
+        "circles=1000",
+        "polygons=200,circles=200,depth=32",
+        "uses=500,vertices=8",
+        "width=4000,height=4000,polygons=50,circles=50"};
+
+    //! Phases of a conversion, in execution order.
+    enum Phase
+    {
+        LOAD,
+        CONSTRUCT,
+        RASTER,
+        ENCODE,
+        TOTAL,
+        NUM_PHASES
+    };
+    const char *PHASE_NAMES[NUM_PHASES] = {"load", "construct", "raster", "encode", "total"};
+
+    //! One benchmark case: an SVG file and a display name.
+    struct BenchCase
+    {
+        string name;
+        string svg_file;
+    };
+
+    //! Measurements of one conversion.
+    struct Sample
+    {
+        //! Time per phase in milliseconds.
+        double ms[NUM_PHASES];
+        //! Hardware counter deltas per phase.
+        uint64_t counters[NUM_PHASES][PerfCounters::NUM_COUNTERS];
+        //! Allocations, bytes allocated and peak live heap per phase (with --alloc).
+        uint64_t allocations[NUM_PHASES];
+        uint64_t alloc_bytes[NUM_PHASES];
+        int64_t peak_heap[NUM_PHASES];
+    };
+
+    //! Allocation sites reported per case.
+    const size_t TOP_ALLOC_SITES = 5;
+
+    class BenchDriver
+    {
+    private:
+        int reps;
+        string label;
+        string work_dir;
+        ofstream results;
+        //! Hardware counters, or nullptr when not requested/available.
+        const PerfCounters *perf;
+        //! Rendering options.
+        RenderOptions options;
+        //! Count allocations (see Alloc.hpp).
+        bool profile_alloc;
+        //! Context reused by all runs (with --context), or null.
+        unique_ptr<RenderContext> context;
+
+        //! Get the p-th percentile (nearest rank) of a sample.
+        static double percentile(vector<double> v, double p)
+        {
+            sort(v.begin(), v.end());
+            size_t rank = (size_t)(p / 100.0 * v.size() + 0.999999);
+            rank = max<size_t>(1, min(rank, v.size()));
+            return v[rank - 1];
+        }
+
+        //! Records phase boundaries of one conversion into a Sample.
+        class PhaseClock
+        {
+        public:
+            PhaseClock(Sample &sample, const PerfCounters *perf)
+                : sample(sample), perf(perf), start(chrono::steady_clock::now()), last(start)
+            {
+                ::memset(&sample, 0, sizeof(sample));
+                if (perf != nullptr)
+                {
+                    perf->read(last_counters);
+                }
+                if (alloc::enabled())
+                {
+                    alloc::reset_peak();
+                    last_alloc = alloc::counters();
+                }
+            }
+            //! End the given phase (which began at the previous mark).
+            void mark(Phase p)
+            {
+                if (perf != nullptr)
+                {
+                    uint64_t now_counters[PerfCounters::NUM_COUNTERS];
+                    perf->read(now_counters);
+                    for (int c = 0; c < PerfCounters::NUM_COUNTERS; c++)
+                    {
+                        sample.counters[p][c] = now_counters[c] - last_counters[c];
+                        sample.counters[TOTAL][c] += sample.counters[p][c];
+                        last_counters[c] = now_counters[c];
+                    }
+                }
+                if (alloc::enabled())
+                {
+                    alloc::Counters now_alloc = alloc::counters();
+                    sample.allocations[p] = now_alloc.allocations - last_alloc.allocations;
+                    sample.alloc_bytes[p] = now_alloc.bytes - last_alloc.bytes;
+                    sample.peak_heap[p] = now_alloc.peak_bytes;
+                    sample.allocations[TOTAL] += sample.allocations[p];
+                    sample.alloc_bytes[TOTAL] += sample.alloc_bytes[p];
+                    sample.peak_heap[TOTAL] = max(sample.peak_heap[TOTAL], sample.peak_heap[p]);
+                    last_alloc = now_alloc;
+                    alloc::reset_peak();
+                }
+                auto now = chrono::steady_clock::now();
+                sample.ms[p] = chrono::duration<double, milli>(now - last).count();
+                sample.ms[TOTAL] = chrono::duration<double, milli>(now - start).count();
+                last = now;
+            }
+
+        private:
+            Sample &sample;
+            const PerfCounters *perf;
+            chrono::steady_clock::time_point start, last;
+            uint64_t last_counters[PerfCounters::NUM_COUNTERS];
+            alloc::Counters last_alloc;
+        };
+
+        //! Run one conversion, recording each phase.
+        void run_once(const BenchCase &bc, Sample &sample, Point &dimensions, size_t &n_elements,
+                      GeometryStats &geometry)
+        {
+            string png_file = work_dir + "/" + bc.name + ".png";
+            PhaseClock clock(sample, perf);
+            if (context != nullptr)
+            {
+                // The same phases, with the buffers of the previous runs.
+                context->load(bc.svg_file);
+                clock.mark(LOAD);
+                context->build(options);
+                const Scene &scene = context->scene();
+                dimensions = {scene.width, scene.height};
+                n_elements = scene.elements.size();
+                clock.mark(CONSTRUCT);
+                PNGImage &img = context->render(options);
+                clock.mark(RASTER);
+                img.save(png_file);
+                clock.mark(ENCODE);
+                return;
+            }
+
+            tinyxml2::XMLDocument doc;
+            {
+                TRACE_SCOPE("XMLDocument::LoadFile", "parse");
+                if (doc.LoadFile(bc.svg_file.c_str()) != tinyxml2::XML_SUCCESS)
+                {
+                    throw runtime_error("Unable to load " + bc.svg_file);
+                }
+            }
+            clock.mark(LOAD);
+
+            vector<SVGElement *> svg_elements;
+            readSVG(doc, dimensions, svg_elements, options.jobs);
+            n_elements = svg_elements.size();
+            if (options.share_geometry)
+            {
+                geometry = share_geometry(svg_elements);
+            }
+            clock.mark(CONSTRUCT);
+
+            {
+                PNGImage img(dimensions.x, dimensions.y);
+                img.set_antialiasing(options.antialiasing);
+                for (SVGElement *e : svg_elements)
+                {
+                    e->draw(img);
+                }
+                clock.mark(RASTER);
+
+                img.save(png_file);
+                clock.mark(ENCODE);
+            }
+            for (SVGElement *e : svg_elements)
+            {
+                delete e;
+            }
+        }
+
+    public:
+        BenchDriver(int reps, const string &label, const string &work_dir, const string &output_file,
+                    const PerfCounters *perf, const RenderOptions &options, bool profile_alloc, bool use_context)
+            : reps(reps), label(label), work_dir(work_dir), results(output_file.c_str(), ios::app), perf(perf),
+              options(options), profile_alloc(profile_alloc), context(use_context ? new RenderContext() : nullptr)
+        {
+        }
+
+        void run_case(const BenchCase &bc)
+        {
+            vector<double> samples[NUM_PHASES];
+            vector<double> counter_samples[NUM_PHASES][PerfCounters::NUM_COUNTERS];
+            vector<double> alloc_samples[NUM_PHASES], alloc_byte_samples[NUM_PHASES], peak_heap_samples[NUM_PHASES];
+            Point dimensions = {0, 0};
+            size_t n_elements = 0;
+            GeometryStats geometry;
+            // One untimed warm-up run (page cache, allocator).
+            Sample sample;
+            run_once(bc, sample, dimensions, n_elements, geometry);
+            if (profile_alloc)
+            {
+                // Counters and sites cover the timed runs only.
+                alloc::reset_peak_rss();
+                alloc::start();
+            }
+            for (int r = 0; r < reps; r++)
+            {
+                run_once(bc, sample, dimensions, n_elements, geometry);
+                for (int p = 0; p < NUM_PHASES; p++)
+                {
+                    samples[p].push_back(sample.ms[p]);
+                    alloc_samples[p].push_back((double)sample.allocations[p]);
+                    alloc_byte_samples[p].push_back((double)sample.alloc_bytes[p]);
+                    peak_heap_samples[p].push_back((double)sample.peak_heap[p]);
+                    for (int c = 0; c < PerfCounters::NUM_COUNTERS; c++)
+                    {
+                        counter_samples[p][c].push_back((double)sample.counters[p][c]);
+                    }
+                }
+            }
+            vector<alloc::Site> sites;
+            uint64_t peak_rss_kb = 0;
+            if (profile_alloc)
+            {
+                alloc::stop();
+                sites = alloc::sites();
+                sites.resize(min(sites.size(), TOP_ALLOC_SITES));
+                peak_rss_kb = alloc::peak_rss_kb();
+            }
+            double pixels = max(1.0, (double)dimensions.x * dimensions.y);
+
+            // Machine-readable record: one JSON object per line.
+            results << fixed << setprecision(4)
+                    << "{\"label\":\"" << label << "\""
+                    << ",\"case\":\"" << bc.name << "\""
+                    << ",\"reps\":" << reps
+                    << ",\"antialiasing\":" << (options.antialiasing ? "true" : "false")
+                    << ",\"width\":" << dimensions.x
+                    << ",\"height\":" << dimensions.y
+                    << ",\"elements\":" << n_elements;
+            if (options.share_geometry)
+            {
+                results << ",\"point_lists\":" << geometry.lists
+                        << ",\"unique_point_lists\":" << geometry.unique_lists
+                        << ",\"bytes_saved\":" << geometry.bytes_saved;
+            }
+            if (profile_alloc)
+            {
+                // Sites are averaged over the repetitions.
+                results << ",\"peak_rss_kb\":" << peak_rss_kb << ",\"alloc_sites\":[";
+                for (size_t i = 0; i < sites.size(); i++)
+                {
+                    results << (i > 0 ? "," : "") << "{\"site\":\"" << sites[i].name << "\""
+                            << ",\"allocs\":" << sites[i].allocations / reps
+                            << ",\"bytes\":" << sites[i].bytes / reps << "}";
+                }
+                results << "]";
+            }
+            for (int p = 0; p < NUM_PHASES; p++)
+            {
+                results << ",\"" << PHASE_NAMES[p] << "\":{\"median_ms\":" << percentile(samples[p], 50)
+                        << ",\"p95_ms\":" << percentile(samples[p], 95);
+                if (profile_alloc)
+                {
+                    results << ",\"allocs\":" << (uint64_t)percentile(alloc_samples[p], 50)
+                            << ",\"alloc_bytes\":" << (uint64_t)percentile(alloc_byte_samples[p], 50)
+                            << ",\"peak_heap_bytes\":" << (int64_t)percentile(peak_heap_samples[p], 50);
+                }
+                if (perf != nullptr)
+                {
+                    // Median counter values, and derived ratios of those medians.
+                    double median[PerfCounters::NUM_COUNTERS];
+                    for (int c = 0; c < PerfCounters::NUM_COUNTERS; c++)
+                    {
+                        median[c] = percentile(counter_samples[p][c], 50);
+                        if (perf->has((PerfCounters::Counter)c))
+                        {
+                            results << ",\"" << PerfCounters::NAMES[c] << "\":" << (uint64_t)median[c];
+                        }
+                    }
+                    if (perf->has(PerfCounters::CYCLES) && perf->has(PerfCounters::INSTRUCTIONS))
+                    {
+                        results << ",\"ipc\":" << median[PerfCounters::INSTRUCTIONS] / max(1.0, median[PerfCounters::CYCLES]);
+                    }
+                    if (perf->has(PerfCounters::CACHE_MISSES))
+                    {
+                        results << ",\"cache_misses_per_pixel\":" << median[PerfCounters::CACHE_MISSES] / pixels;
+                    }
+                    if (perf->has(PerfCounters::BRANCH_MISSES))
+                    {
+                        results << ",\"branch_misses_per_pixel\":" << median[PerfCounters::BRANCH_MISSES] / pixels;
+                    }
+                }
+                results << "}";
+            }
+            results << "}" << endl;
+
+            // Human-readable summary: median (p95) per phase.
+            cout << left << setw(44) << bc.name << right << fixed << setprecision(2);
+            for (int p = 0; p < NUM_PHASES; p++)
+            {
+                cout << setw(10) << percentile(samples[p], 50)
+                     << " (" << setw(8) << percentile(samples[p], 95) << ")";
+            }
+            cout << endl;
+            if (options.share_geometry)
+            {
+                cout << "  point lists: " << geometry.lists << ", unique: " << geometry.unique_lists
+                     << ", bytes saved: " << geometry.bytes_saved << endl;
+            }
+            if (profile_alloc)
+            {
+                // Allocations and peak live heap (KiB) for each phase, then the top sites.
+                cout << left << setw(44) << "  allocs (peak KiB)" << right;
+                for (int p = 0; p < NUM_PHASES; p++)
+                {
+                    cout << setw(10) << (uint64_t)percentile(alloc_samples[p], 50)
+                         << " (" << setw(8) << (int64_t)percentile(peak_heap_samples[p], 50) / 1024 << ")";
+                }
+                cout << endl << "  peak RSS " << peak_rss_kb << " KiB; top sites:";
+                for (const alloc::Site &site : sites)
+                {
+                    cout << ' ' << site.name << ' ' << site.allocations / reps << " (" << site.bytes / reps / 1024 << " KiB)";
+                }
+                cout << endl;
+            }
+            if (perf != nullptr)
+            {
+                // IPC, cache misses per pixel and branch misses per pixel for each phase.
+                cout << left << setw(44) << "  ipc cm/px bm/px" << right;
+                for (int p = 0; p < NUM_PHASES; p++)
+                {
+                    double cycles = percentile(counter_samples[p][PerfCounters::CYCLES], 50);
+                    double instructions = percentile(counter_samples[p][PerfCounters::INSTRUCTIONS], 50);
+                    double cache_misses = percentile(counter_samples[p][PerfCounters::CACHE_MISSES], 50);
+                    double branch_misses = percentile(counter_samples[p][PerfCounters::BRANCH_MISSES], 50);
+                    cout << setw(7) << setprecision(2) << instructions / max(1.0, cycles)
+                         << setw(7) << setprecision(3) << cache_misses / pixels
+                         << setw(7) << setprecision(3) << branch_misses / pixels;
+                }
+                cout << endl;
+            }
+        }
+
+        static void print_header()
+        {
+            cout << left << setw(44) << "case" << right;
+            for (int p = 0; p < NUM_PHASES; p++)
+            {
+                cout << setw(21) << (string(PHASE_NAMES[p]) + " ms (p95)");
+            }
+            cout << endl;
+        }
+    };
+
+    //! List the SVG files of a directory, sorted by name.
+    vector<BenchCase> corpus_cases(const string &dir_path)
+    {
+        vector<BenchCase> cases;
+        ::DIR *directory = ::opendir(dir_path.c_str());
+        if (directory == nullptr)
+        {
+            cerr << "Unable to open input directory " << dir_path << endl;
+            return cases;
+        }
+        ::dirent *entry;
+        while ((entry = readdir(directory)) != nullptr)
+        {
+            string fname = entry->d_name;
+            if (fname.size() > 4 && fname.compare(fname.size() - 4, 4, ".svg") == 0)
+            {
+                cases.push_back({fname.substr(0, fname.size() - 4), dir_path + "/" + fname});
+            }
+        }
+        ::closedir(directory);
+        sort(cases.begin(), cases.end(),
+             [](const BenchCase &a, const BenchCase &b)
+             { return a.name < b.name; });
+        return cases;
+    }
+
+    //! Generate a synthetic SVG file in the work directory.
+    BenchCase synth_case(const string &spec, const string &work_dir)
+    {
+        SynthParams params = parse_synth_params(spec);
+        string name = "synth_" + synth_name(params);
+        string svg_file = work_dir + "/" + name + ".svg";
+        ofstream out(svg_file.c_str());
+        generate_svg(params, out);
+        return {name, svg_file};
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int reps = 10;
+    string label = "unlabeled";
+    string root_path = ".";
+    string work_dir = "bench_obj/work";
+    string output_file = svg::BENCH_OUTPUT_FILE;
+    bool corpus = true, synth = true, use_perf = false, profile_alloc = false, use_context = false;
+    svg::RenderOptions options;
+    vector<string> synth_specs;
+    vector<string> filters;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--reps" && has_value) reps = atoi(argv[++i]);
+        else if (arg == "--label" && has_value) label = argv[++i];
+        else if (arg == "--root" && has_value) root_path = argv[++i];
+        else if (arg == "--work-dir" && has_value) work_dir = argv[++i];
+        else if (arg == "--out" && has_value) output_file = argv[++i];
+        else if (arg == "--gen" && has_value) synth_specs.push_back(argv[++i]);
+        else if (arg == "--no-corpus") corpus = false;
+        else if (arg == "--no-synth") synth = false;
+        else if (arg == "--perf") use_perf = true;
+        else if (arg == "--alloc") profile_alloc = true;
+        else if (arg == "--context") use_context = true;
+        else if (arg == "--aa") options.antialiasing = true;
+        else if (arg == "--share-geometry") options.share_geometry = true;
+        else if (arg == "--jobs" && has_value) options.jobs = atoi(argv[++i]);
+        else if (arg.size() > 0 && arg[0] != '-') filters.push_back(arg);
+        else
+        {
+            cout << "Usage: svgbench [--reps N] [--label L] [--root DIR] [--work-dir DIR] [--out FILE]" << endl
+                 << "                [--gen key=value,...]... [--no-corpus] [--no-synth] [--perf] [--alloc] [--context] [--aa]" << endl
+                 << "                [--share-geometry] [--jobs N] [case_prefix...]" << endl;
+            return 1;
+        }
+    }
+    if (reps < 1)
+    {
+        cerr << "Invalid number of repetitions" << endl;
+        return 1;
+    }
+    ::mkdir(work_dir.c_str(), 0755);
+
+    vector<svg::BenchCase> cases;
+    if (synth)
+    {
+        if (synth_specs.empty())
+        {
+            synth_specs.assign(std::begin(svg::DEFAULT_SYNTH_CASES), std::end(svg::DEFAULT_SYNTH_CASES));
+        }
+        for (const string &spec : synth_specs)
+        {
+            cases.push_back(svg::synth_case(spec, work_dir));
+        }
+    }
+    if (corpus)
+    {
+        vector<svg::BenchCase> c = svg::corpus_cases(root_path + "/input");
+        cases.insert(cases.end(), c.begin(), c.end());
+    }
+
+    svg::PerfCounters counters;
+    const svg::PerfCounters *perf = nullptr;
+    if (use_perf)
+    {
+        if (counters.available())
+        {
+            perf = &counters;
+        }
+        if (!counters.error().empty())
+        {
+            cerr << "Some hardware counters are unavailable: " << counters.error()
+                 << (perf == nullptr ? "; reporting timings only" : "") << endl;
+        }
+    }
+    svg::BenchDriver driver(reps, label, work_dir, output_file, perf, options, profile_alloc, use_context);
+    svg::BenchDriver::print_header();
+    for (const svg::BenchCase &bc : cases)
+    {
+        bool selected = filters.empty();
+        for (const string &f : filters)
+        {
+            selected = selected || bc.name.find(f) == 0;
+        }
+        if (selected)
+        {
+            driver.run_case(bc);
+        }
+    }
+    cout << "Results written to " << output_file << endl;
+    return 0;
+}
@@ -1,23 +1,211 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
 #include <string>
+#include <thread>
 #include <vector>
 #include "SVGElements.hpp"
+#include "Optimize.hpp"
+#include "Trace.hpp"
+#include "external/tinyxml2/tinyxml2.h"
 
 namespace svg
 {
+    Scene::~Scene()
+    {
+        clear();
+    }
+
+    void Scene::clear()
+    {
+        for (SVGElement* e : elements)
+        {
+            delete e;
+        }
+        elements.clear();
+    }
+
     void convert(const std::string &svg_file, const std::string &png_file)
+    {
+        convert(svg_file, png_file, RenderOptions());
+    }
+
+    namespace
+    {
+        //! Compute the output size of a scene whose elements were just read,
+        //! then apply the view, optimize (if enabled) and cull the elements.
+        void view_scene(const Point &dimensions, const RenderOptions &options, Scene &scene, OptimizeStats *stats)
+        {
+            std::vector<SVGElement *> &svg_elements = scene.elements;
+            // The view maps the region to the output image. Geometry is scaled
+            // before rasterization, so only the output-sized image is allocated.
+            double region_x = 0, region_y = 0;
+            double region_width = dimensions.x, region_height = dimensions.y;
+            if (options.region_width > 0 && options.region_height > 0)
+            {
+                region_x = options.region_x;
+                region_y = options.region_y;
+                region_width = options.region_width;
+                region_height = options.region_height;
+            }
+            int width = std::max(1, (int)std::ceil(region_width * options.scale));
+            int height = std::max(1, (int)std::ceil(region_height * options.scale));
+            scene.width = width;
+            scene.height = height;
+
+            TRACE_SCOPE("view", "convert");
+            if (options.scale != 1.0 || region_x != 0 || region_y != 0)
+            {
+                Transform view = Transform::view({to_fixed(region_x), to_fixed(region_y)}, options.scale);
+                for (SVGElement* e : svg_elements)
+                {
+                    e->apply_transform(view);
+                }
+            }
+            if (options.optimize)
+            {
+                OptimizeStats optimized = optimize_scene(svg_elements, width, height, options.antialiasing);
+                if (stats != nullptr)
+                {
+                    *stats = optimized;
+                }
+            }
+            // Skip the elements outside the image or below the size threshold.
+            BoundingBox image = {0, 0, to_fixed(width - 1), to_fixed(height - 1)};
+            fixed_value min_size = to_fixed(options.min_size);
+            size_t n = 0;
+            for (SVGElement* e : svg_elements)
+            {
+                if (e->visible(image, min_size))
+                {
+                    e->cull(image, min_size);
+                    svg_elements[n++] = e;
+                }
+                else
+                {
+                    delete e;
+                }
+            }
+            svg_elements.resize(n);
+        }
+
+        //! Draw a prepared scene and save it.
+        void render_scene(const Scene &scene, const RenderOptions &options, const std::string &png_file,
+                          PixelFormat format)
+        {
+            PNGImage img(scene.width, scene.height, options.storage);
+            img.set_antialiasing(options.antialiasing);
+            {
+                TRACE_SCOPE("raster", "convert");
+                for (SVGElement* e : scene.elements)
+                {
+                    e->draw(img);
+                }
+            }
+            img.save(png_file, format);
+        }
+    }
+
+    void load_scene(const std::string &svg_file, const RenderOptions &options, Scene &scene, OptimizeStats *stats)
+    {
+        tinyxml2::XMLDocument doc;
+        load_document(svg_file, doc);
+        load_scene(doc, options, scene, stats);
+    }
+
+    void load_scene(tinyxml2::XMLDocument &doc, const RenderOptions &options, Scene &scene, OptimizeStats *stats)
     {
         Point dimensions;
-        std::vector<SVGElement *> svg_elements;
-        readSVG(svg_file, dimensions, svg_elements);
-        PNGImage img(dimensions.x, dimensions.y);
-        for (SVGElement* e : svg_elements)
+        readSVG(doc, dimensions, scene.elements, options.jobs);
+        if (options.share_geometry)
         {
-            e->draw(img);
+            share_geometry(scene.elements);
         }
-        img.save(png_file);
-        for (SVGElement* e  : svg_elements)
+        view_scene(dimensions, options, scene, stats);
+    }
+
+    void convert(const std::string &svg_file, const std::string &png_file, const RenderOptions &options,
+                 OptimizeStats *stats)
+    {
+        trace::Session session;
         {
-            delete e;
+            TRACE_SCOPE("convert", "convert");
+            Scene scene;
+            load_scene(svg_file, options, scene, stats);
+            render_scene(scene, options, png_file, PixelFormat::RGB);
+            TRACE_SCOPE("cleanup", "convert");
+            scene.clear();
+        }
+    }
+
+    void convert(const std::string &svg_file, const std::vector<OutputSpec> &outputs, const RenderOptions &options)
+    {
+        trace::Session session;
+        {
+            TRACE_SCOPE("convert", "convert");
+            // Elements in document units, shared (read-only) by all the outputs.
+            Point dimensions;
+            Scene document;
+            readSVG(svg_file, dimensions, document.elements, options.jobs);
+            if (options.share_geometry)
+            {
+                // The copies share the storage too, until scaled.
+                share_geometry(document.elements);
+            }
+
+            std::vector<std::exception_ptr> errors(outputs.size());
+            std::atomic<size_t> next_output(0);
+            auto worker = [&]()
+            {
+                for (size_t i = next_output++; i < outputs.size(); i = next_output++)
+                {
+                    TRACE_SCOPE("output", "convert");
+                    const OutputSpec &spec = outputs[i];
+                    try
+                    {
+                        RenderOptions view = options;
+                        view.scale = spec.scale;
+                        view.region_x = spec.region_x;
+                        view.region_y = spec.region_y;
+                        view.region_width = spec.region_width;
+                        view.region_height = spec.region_height;
+                        Scene scene;
+                        scene.elements.reserve(document.elements.size());
+                        for (const SVGElement *e : document.elements)
+                        {
+                            scene.elements.push_back(e->clone());
+                        }
+                        view_scene(dimensions, view, scene, nullptr);
+                        render_scene(scene, view, spec.png_file, spec.format);
+                    }
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
+                    }
+                }
+            };
+            int n_threads = options.jobs > 0 ? options.jobs : (int)std::thread::hardware_concurrency();
+            n_threads = std::max(1, std::min(n_threads, (int)outputs.size()));
+            std::vector<std::thread> threads;
+            for (int t = 1; t < n_threads; t++)
+            {
+                threads.emplace_back(worker);
+            }
+            worker();
+            for (std::thread &t : threads)
+            {
+                t.join();
+            }
+            TRACE_SCOPE("cleanup", "convert");
+            document.clear();
+            for (const std::exception_ptr &error : errors)
+            {
+                if (error)
+                {
+                    std::rethrow_exception(error);
+                }
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -1,7 +1,15 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
 #include <iostream>
-#include <sstream>
+#include <thread>
 #include <unordered_map>
 #include "SVGElements.hpp"
+#include "Trace.hpp"
 #include "external/tinyxml2/tinyxml2.h"
 
 using namespace std;
@@ -9,194 +17,487 @@ using namespace tinyxml2;
 
 namespace svg
 {
-    void readXMLElement(XMLElement* xml_elem,vector<SVGElement *>& svg_elements,std::unordered_map<std::string, SVGElement*> id_map);
+    void readXMLElement(XMLElement* xml_elem,vector<SVGElement *>& svg_elements,std::unordered_map<std::string, SVGElement*> id_map,
+                        const vector<SVGElement *>& shapes, size_t& next_shape);
 
-    void readSVG(const string& svg_file, Point& dimensions, vector<SVGElement *>& svg_elements)
+    // Reads a coordinate or length attribute as fixed-point, keeping its fractional part.
+    fixed_value FixedAttribute(XMLElement* element, const char* name)
     {
-        XMLDocument doc;
-        XMLError r = doc.LoadFile(svg_file.c_str());
-        if (r != XML_SUCCESS)
+        return to_fixed(element->DoubleAttribute(name));
+    }
+
+    // Reads a decimal number (as operator>> would) and moves s past it.
+    static bool read_coordinate(const char*& s, double& v)
+    {
+        const char* p = s + (*s == '+' || *s == '-');
+        if (!isdigit((unsigned char)*p) && !(*p == '.' && isdigit((unsigned char)p[1]))) return false;
+        char* end;
+        v = strtod(s, &end);
+        s = end;
+        return true;
+    }
+
+    // Parses a points attribute into a points vector (cleared first), without
+    // allocating once the vector is large enough.
+    void parse_points(const char* s, vector<FixedPoint>& points)
+    {
+        points.clear();
+        if (s == nullptr) return;
+        double x, y = 0;
+        // Assuming points can be separated by any simbol and x and y values inside points are always separated with a comma.
+        while (true) {
+            while (isspace((unsigned char)*s)) s++;
+            if (*s == '\0') break;
+            if (!read_coordinate(s, x))
+            {
+                s++;
+                continue;
+            }
+            // Separator: any single character after x.
+            while (isspace((unsigned char)*s)) s++;
+            if (*s != '\0')
+            {
+                s++;
+                while (isspace((unsigned char)*s)) s++;
+                if (!read_coordinate(s, y))
+                {
+                    y = 0;
+                    if (*s != '\0') s++;
+                }
+            }
+            points.push_back({to_fixed(x), to_fixed(y)});
+        }
+    }
+
+    void load_document(const string& svg_file, XMLDocument& doc)
+    {
+        TRACE_SCOPE("XMLDocument::LoadFile", "parse");
+        if (doc.LoadFile(svg_file.c_str()) != XML_SUCCESS)
         {
             throw runtime_error("Unable to load " + svg_file);
         }
-        XMLElement *xml_elem = doc.RootElement();
-
-        dimensions.x = xml_elem->IntAttribute("width");
-        dimensions.y = xml_elem->IntAttribute("height");
-        
-        /*Per each child node, an object should be dynamically allocated 
-        using new for the corresponding type of SVGElement, and be stored 
-        in the elements vector
-        To read colors use Color parse(std::string) function (see Color.hpp
-        /Color.cpp)
-        */
+    }
 
-       //unordered map container used to correlate objects with their specific ids. 
-       std::unordered_map<std::string, SVGElement*> id_map;
-       readXMLElement(xml_elem,svg_elements,id_map);
+    void readSVG(const string& svg_file, Point& dimensions, vector<SVGElement *>& svg_elements, int jobs)
+    {
+        TRACE_SCOPE("readSVG", "parse");
+        XMLDocument doc;
+        load_document(svg_file, doc);
+        readSVG(doc, dimensions, svg_elements, jobs);
     }
-    
-    void readXMLElement(XMLElement* xml_elem,vector<SVGElement *>& svg_elements,std::unordered_map<std::string, SVGElement*> id_map){
 
-        // Iterates over the Child nodes.
-        for (XMLElement* element = xml_elem->FirstChildElement(); element != nullptr; element = element->NextSiblingElement()) {
-            // Name of the svg element.
-            std::string elementType = element->Name();
-            // If there is none, "transform" will be nullpointer.
-            const char* transform = element->Attribute("transform");
-            // If there is none, "origin" will be nullpointer.
-            const char* origin = element->Attribute("transform-origin"); 
-            // If there is none, "id" will be nullpointer. 
-            const char* id = element->Attribute("id");
+    // Shapes are built on up to one thread per this much work, counted as
+    // SHAPE_COST per shape plus the length of its points attribute.
+    const size_t SHAPE_COST = 64;
+    const size_t WORK_PER_THREAD = 16384;
+    // Shapes handed to a thread at a time.
+    const size_t SHAPE_BATCH = 16;
 
-            //strcmp compares the strings and returns a int type ( 0 if equal, -1 if 1st < 2nd and 1 if 1st > 2nd ).
+    // Collects the shape elements (all but groups and uses) below xml_elem in
+    // document order, the order in which readXMLElement consumes them.
+    void collect_shape_elements(XMLElement* xml_elem, vector<XMLElement*>& shape_elements, size_t& work)
+    {
+        for (XMLElement* element = xml_elem->FirstChildElement(); element != nullptr; element = element->NextSiblingElement()) {
+            if (std::strcmp(element->Name(), "g") == 0)
+            {
+                collect_shape_elements(element, shape_elements, work);
+            }
+            else if (std::strcmp(element->Name(), "use") != 0)
+            {
+                shape_elements.push_back(element);
+                // Point lists and path data dominate the parsing time.
+                const char* points = element->Attribute("points");
+                if (points == nullptr) points = element->Attribute("d");
+                work += SHAPE_COST + (points != nullptr ? std::strlen(points) : 0);
+            }
+        }
+    }
 
-            if (elementType == "line")   // If element type is line.
-            { 
-                // Attributes needed for the line constructor.
-                Point start,end;
-                Color stroke = parse_color(element->Attribute("stroke"));
-                start = {element->IntAttribute("x1"),element->IntAttribute("y1")};
-                end = {element->IntAttribute("x2"),element->IntAttribute("y2")};
+    // Gradient definition. With gradientUnits="objectBoundingBox" (the default),
+    // its geometry is in fractions of the bounds of the shapes it fills.
+    struct GradientDefinition
+    {
+        std::shared_ptr<const Gradient> gradient;
+        bool bounding_box;
+    };
+    typedef std::unordered_map<std::string, GradientDefinition> GradientMap;
 
-                // Create dynamically allocated line object.
-                Line* line_elem = new Line({start, end}, stroke);
+    // Reads a gradient coordinate: a number, or a percentage of length.
+    double gradient_length(XMLElement* element, const char* name, double default_value, double length)
+    {
+        const char* value = element->Attribute(name);
+        if (value == nullptr) return default_value;
+        char* end;
+        double v = std::strtod(value, &end);
+        return *end == '%' ? v / 100 * length : v;
+    }
 
-                line_elem->transform(transform,origin);
-                svg_elements.push_back(line_elem);
+    // Collects the gradient elements with an id, wherever they are (usually in <defs>).
+    void collect_gradient_elements(XMLElement* xml_elem, std::unordered_map<std::string, XMLElement*>& gradient_elements)
+    {
+        for (XMLElement* element = xml_elem->FirstChildElement(); element != nullptr; element = element->NextSiblingElement()) {
+            const char* id = element->Attribute("id");
+            if (std::strcmp(element->Name(), "linearGradient") == 0 || std::strcmp(element->Name(), "radialGradient") == 0)
+            {
+                if (id) gradient_elements[id] = element;
+            }
+            else
+            {
+                collect_gradient_elements(element, gradient_elements);
+            }
+        }
+    }
 
-                if (id) id_map[id] = line_elem;
+    // Reads the stops of a gradient. A gradient without stops takes those of
+    // the gradient it references with href, if any.
+    vector<GradientStop> read_stops(XMLElement* element, const std::unordered_map<std::string, XMLElement*>& gradient_elements)
+    {
+        vector<GradientStop> stops;
+        // The depth limit stops reference cycles.
+        for (int depth = 0; element != nullptr && depth < 16; depth++)
+        {
+            double offset = 0;
+            for (XMLElement* stop = element->FirstChildElement("stop"); stop != nullptr; stop = stop->NextSiblingElement("stop")) {
+                // Offsets are clamped to [0, 1] and never decrease.
+                offset = std::max(offset, std::min(1.0, gradient_length(stop, "offset", 0, 1)));
+                const char* color = stop->Attribute("stop-color");
+                double stop_opacity = std::min(1.0, std::max(0.0, stop->DoubleAttribute("stop-opacity", 1.0)));
+                stops.push_back({offset, parse_color(color != nullptr ? color : "black"), stop_opacity});
             }
+            const char* href = element->Attribute("href");
+            if (href == nullptr) href = element->Attribute("xlink:href");
+            if (!stops.empty() || href == nullptr || href[0] != '#') break;
+            auto it = gradient_elements.find(href + 1);
+            element = it != gradient_elements.end() ? it->second : nullptr;
+        }
+        return stops;
+    }
 
-            else if (elementType == "polyline")  // If element is of type polyline.
-            {    
-                // Attribute needed for the polyline constructor
-                std::vector<Point> points;                
-                Color stroke = parse_color(element->Attribute("stroke"));            
-                const char* points_cstr = element->Attribute("points");
-
-                // Processing the points string and parsing to a points vector.
-                std::istringstream iss(points_cstr);
-                int x, y;
-                char comma;
-                // Assuming points can be separated by any simbol and x and y values inside points are always separated with a comma.
-                while (!iss.eof()) {
-                    if (iss >> x)
-                    {
-                        iss >> comma >> y;
-                        points.push_back({x, y});
-                    }
-                    else{
-                        iss.clear();
-                        iss.ignore();
-                    }
-                }
+    // Reads the linear and radial gradients of the document, by id. Their
+    // ramps are sampled once here and shared by all the shapes they fill.
+    GradientMap read_gradients(XMLElement* root, const Point& dimensions)
+    {
+        TRACE_SCOPE("readGradients", "parse");
+        std::unordered_map<std::string, XMLElement*> gradient_elements;
+        collect_gradient_elements(root, gradient_elements);
+        GradientMap gradients;
+        for (const auto& entry : gradient_elements)
+        {
+            XMLElement* element = entry.second;
+            const char* units = element->Attribute("gradientUnits");
+            bool bounding_box = units == nullptr || std::strcmp(units, "userSpaceOnUse") != 0;
+            // Percentages are relative to the bounds, or to the canvas in user units.
+            double w = bounding_box ? 1 : dimensions.x, h = bounding_box ? 1 : dimensions.y;
+            double diagonal = std::sqrt((w * w + h * h) / 2);
+            vector<GradientStop> stops = read_stops(element, gradient_elements);
+            Gradient gradient = std::strcmp(element->Name(), "linearGradient") == 0
+                ? Gradient::linear({gradient_length(element, "x1", 0, w), gradient_length(element, "y1", 0, h)},
+                                   {gradient_length(element, "x2", w, w), gradient_length(element, "y2", 0, h)}, stops)
+                : Gradient::radial({gradient_length(element, "cx", w / 2, w), gradient_length(element, "cy", h / 2, h)},
+                                   gradient_length(element, "r", diagonal / 2, diagonal), stops);
+            gradients[entry.first] = {std::make_shared<Gradient>(gradient), bounding_box};
+        }
+        return gradients;
+    }
 
-                // Dynamcally allocated polyline object
-                Polyline* polyline_elem = new Polyline(points, stroke);
+    // Finds the gradient of a fill="url(#id)" attribute, or returns nullptr for
+    // a color. Unknown ids get a gradient without stops, which paints nothing.
+    const GradientDefinition* find_gradient(const char* fill, const GradientMap& gradients)
+    {
+        static const GradientDefinition none = {std::make_shared<Gradient>(Gradient::linear({0, 0}, {1, 0}, {})), false};
+        if (fill == nullptr || std::strncmp(fill, "url(#", 5) != 0) return nullptr;
+        const char* end = std::strchr(fill, ')');
+        auto it = gradients.find(std::string(fill + 5, end != nullptr ? end : fill + std::strlen(fill)));
+        return it != gradients.end() ? &it->second : &none;
+    }
 
-                polyline_elem->transform(transform,origin);
-                svg_elements.push_back(polyline_elem);
+    // Fills a shape with a gradient, if any, mapping objectBoundingBox units to
+    // the shape bounds. Called before the shape transform, which then moves both.
+    template <class Shape>
+    void set_fill_gradient(Shape* shape, const GradientDefinition* gradient)
+    {
+        if (gradient == nullptr) return;
+        if (!gradient->bounding_box)
+        {
+            shape->set_gradient(gradient->gradient);
+            return;
+        }
+        BoundingBox b = shape->get_bounds();
+        Vertex lo = FixedPoint{b.x0, b.y0}.vertex(), hi = FixedPoint{b.x1, b.y1}.vertex();
+        Affine box = {hi.x - lo.x, 0, lo.x, 0, hi.y - lo.y, lo.y};
+        shape->set_gradient(std::make_shared<Gradient>(gradient->gradient->transformed(box)));
+    }
 
-                if (id) id_map[id] = polyline_elem;
-            }
+    // Reads the fill color of a shape, or finds its gradient.
+    Color read_fill(XMLElement* element, const GradientMap& gradients, const GradientDefinition*& gradient)
+    {
+        const char* fill = element->Attribute("fill");
+        gradient = find_gradient(fill, gradients);
+        return gradient != nullptr ? Color{0, 0, 0} : parse_color(fill);
+    }
 
-            
-            else if (elementType == "ellipse")    // If element is of type ellipse.
-            {
-                // Attributes needed for the polyline constructor.
-                Point center,radius;
-                Color fill = parse_color(element->Attribute("fill"));
-                center = {element->IntAttribute("cx"),element->IntAttribute("cy")};
-                radius = {element->IntAttribute("rx"),element->IntAttribute("ry")};
+    // Builds a shape element with its opacity, stroke and transform, or returns
+    // nullptr for unsupported elements. Only reads the document, so shapes can
+    // be built concurrently.
+    SVGElement* readShape(XMLElement* element, const GradientMap& gradients)
+    {
+        // Name of the svg element.
+        std::string elementType = element->Name();
+        // If there is none, "transform" will be nullpointer.
+        const char* transform = element->Attribute("transform");
+        // If there is none, "origin" will be nullpointer.
+        const char* origin = element->Attribute("transform-origin"); 
+        // Element opacity; shapes multiply it by their fill/stroke opacity.
+        double opacity = element->DoubleAttribute("opacity", 1.0);
+        double fill_opacity = opacity * element->DoubleAttribute("fill-opacity", 1.0);
+        double stroke_opacity = opacity * element->DoubleAttribute("stroke-opacity", 1.0);
+        // Stroke geometry, used by lines and polylines.
+        StrokeStyle stroke_style;
+        stroke_style.width = element->DoubleAttribute("stroke-width", 1.0);
+        stroke_style.hairline = element->Attribute("stroke-width") == nullptr;
+        stroke_style.join = parse_line_join(element->Attribute("stroke-linejoin"));
+        stroke_style.cap = parse_line_cap(element->Attribute("stroke-linecap"));
+        stroke_style.miter_limit = element->DoubleAttribute("stroke-miterlimit", 4.0);
+        // Fill gradient of filled shapes, if any.
+        const GradientDefinition* gradient = nullptr;
+
+        if (elementType == "line")   // If element type is line.
+        {
+            TRACE_SCOPE("Line::read", "parse");
+            // Attributes needed for the line constructor.
+            FixedPoint start,end;
+            Color stroke = parse_color(element->Attribute("stroke"));
+            start = {FixedAttribute(element,"x1"),FixedAttribute(element,"y1")};
+            end = {FixedAttribute(element,"x2"),FixedAttribute(element,"y2")};
+
+            // Create dynamically allocated line object.
+            Line* line_elem = new Line({start, end}, stroke);
+
+            line_elem->set_opacity(stroke_opacity);
+            line_elem->set_stroke_style(stroke_style);
+            line_elem->transform(transform,origin);
+            return line_elem;
+        }
 
-                // Dynamcally allocated ellipse object.
-                Ellipse* ellipse_elem = new Ellipse(center,radius,fill);
+        else if (elementType == "polyline")  // If element is of type polyline.
+        {
+            TRACE_SCOPE("Polyline::read", "parse");
+            // Attribute needed for the polyline constructor
+            Color stroke = parse_color(element->Attribute("stroke"));            
+            // Parsed into a per-thread buffer, then copied once into the element.
+            thread_local std::vector<FixedPoint> points;
+            parse_points(element->Attribute("points"), points);
+
+            // Dynamcally allocated polyline object
+            Polyline* polyline_elem = new Polyline(points, stroke);
+
+            polyline_elem->set_opacity(stroke_opacity);
+            polyline_elem->set_stroke_style(stroke_style);
+            polyline_elem->transform(transform,origin);
+            return polyline_elem;
+        }
 
-                ellipse_elem->transform(transform,origin);
-                svg_elements.push_back(ellipse_elem);
-                
-                if (id) id_map[id] = ellipse_elem;
-            }
+        
+        else if (elementType == "ellipse")    // If element is of type ellipse.
+        {
+            TRACE_SCOPE("Ellipse::read", "parse");
+            // Attributes needed for the polyline constructor.
+            FixedPoint center,radius;
+            Color fill = read_fill(element, gradients, gradient);
+            center = {FixedAttribute(element,"cx"),FixedAttribute(element,"cy")};
+            radius = {FixedAttribute(element,"rx"),FixedAttribute(element,"ry")};
+
+            // Dynamcally allocated ellipse object.
+            Ellipse* ellipse_elem = new Ellipse(center,radius,fill);
+
+            set_fill_gradient(ellipse_elem, gradient);
+            ellipse_elem->set_opacity(fill_opacity);
+            ellipse_elem->transform(transform,origin);
+            return ellipse_elem;
+        }
 
-            else if (elementType == "circle")     // If element is of type circle.
-            {
-                // Attributes needed for the circle constructor.
-                Point center; int radius;
-                Color fill = parse_color(element->Attribute("fill"));
-                center = {element->IntAttribute("cx"),element->IntAttribute("cy")};
-                radius = element->IntAttribute("r");
+        else if (elementType == "circle")     // If element is of type circle.
+        {
+            TRACE_SCOPE("Circle::read", "parse");
+            // Attributes needed for the circle constructor.
+            FixedPoint center; fixed_value radius;
+            Color fill = read_fill(element, gradients, gradient);
+            center = {FixedAttribute(element,"cx"),FixedAttribute(element,"cy")};
+            radius = FixedAttribute(element,"r");
+
+            // Dynamcally allocated circle object.
+            Circle* circle_elem = new Circle(center,radius,fill);
+
+            set_fill_gradient(circle_elem, gradient);
+            circle_elem->set_opacity(fill_opacity);
+            circle_elem->transform(transform,origin);
+            return circle_elem;
+        }
 
-                // Dynamcally allocated circle object.
-                Circle* circle_elem = new Circle(center,radius,fill);
+        
+        else if (elementType == "polygon")    // If element is of type polygon.
+        {
+            TRACE_SCOPE("Polygon::read", "parse");
+            Color fill = read_fill(element, gradients, gradient);
+            thread_local std::vector<FixedPoint> points;
+            parse_points(element->Attribute("points"), points);
+            // Dynamcally allocated Polygon object.
+            Polygon* polygon_elem = new Polygon(points, fill);
+
+            set_fill_gradient(polygon_elem, gradient);
+            polygon_elem->set_opacity(fill_opacity);
+            polygon_elem->transform(transform,origin);
+            return polygon_elem;
+        }
 
-                circle_elem->transform(transform,origin);
-                svg_elements.push_back(circle_elem);
+        else if (elementType == "rect")   // If element is of type rectangle.
+        {
+            TRACE_SCOPE("Rectangle::read", "parse");
+            // Atributes needed for the rect constructor
+            FixedPoint top_left; fixed_value width, height;
+           
+            Color fill = read_fill(element, gradients, gradient);
+        
+            top_left = {FixedAttribute(element,"x"),FixedAttribute(element,"y")};
+            width = FixedAttribute(element,"width");
+            height = FixedAttribute(element,"height");
+            
+            // Dynamically allocated rectangle object.
+            Rectangle* rect_elem = new Rectangle(top_left,width,height,fill);
+            
+            set_fill_gradient(rect_elem, gradient);
+            rect_elem->set_opacity(fill_opacity);
+            rect_elem->transform(transform,origin);
+            return rect_elem;
+        }
 
-                if (id)id_map[id] = circle_elem;
-            }
+        else if (elementType == "path")   // If element is of type path.
+        {
+            TRACE_SCOPE("Path::read", "parse");
+            Color fill = read_fill(element, gradients, gradient);
+            std::vector<PathVerb> verbs;
+            std::vector<FixedPoint> points;
+            parse_path_data(element->Attribute("d"), verbs, points);
+            // Dynamically allocated path object.
+            Path* path_elem = new Path(verbs, points, fill, parse_fill_rule(element->Attribute("fill-rule")));
+
+            set_fill_gradient(path_elem, gradient);
+            path_elem->set_opacity(fill_opacity);
+            path_elem->transform(transform,origin);
+            return path_elem;
+        }
+        return nullptr;
+    }
 
-            
-            else if (elementType == "polygon")    // If element is of type polygon.
+    // Builds the shapes, in the order of shape_elements, on up to jobs threads
+    // (0: one per hardware thread). The first error, in document order, is rethrown.
+    void readShapes(const vector<XMLElement*>& shape_elements, const GradientMap& gradients, size_t work, int jobs,
+                    vector<SVGElement *>& shapes)
+    {
+        TRACE_SCOPE("readShapes", "parse");
+        shapes.assign(shape_elements.size(), nullptr);
+        vector<std::exception_ptr> errors(shape_elements.size());
+        std::atomic<size_t> next_batch(0);
+        auto worker = [&]()
+        {
+            for (size_t first = next_batch++ * SHAPE_BATCH; first < shapes.size(); first = next_batch++ * SHAPE_BATCH)
             {
-                std::vector<Point> points;
-                Color fill = parse_color(element->Attribute("fill"));
-                const char* pointsStr = element->Attribute("points");
-
-                // Processing the points string and parsing to a points vector.
-                std::istringstream iss(pointsStr);
-                int x, y;
-                char comma;
-                while (!iss.eof()) {
-                    if (iss >> x)
+                for (size_t i = first; i < std::min(first + SHAPE_BATCH, shapes.size()); i++)
+                {
+                    try
                     {
-                        iss >> comma >> y;
-                        points.push_back({x, y});
+                        shapes[i] = readShape(shape_elements[i], gradients);
                     }
-                    else{
-                        iss.clear();
-                        iss.ignore();
+                    catch (...)
+                    {
+                        errors[i] = std::current_exception();
                     }
                 }
-                // Dynamcally allocated Polygon object.
-                Polygon* polygon_elem = new Polygon(points, fill);
+            }
+        };
+        int n_threads = jobs > 0 ? jobs : (int)std::thread::hardware_concurrency();
+        n_threads = std::max(1, std::min(n_threads, (int)(work / WORK_PER_THREAD)));
+        std::vector<std::thread> threads;
+        for (int t = 1; t < n_threads; t++)
+        {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (std::thread &t : threads)
+        {
+            t.join();
+        }
+        for (size_t i = 0; i < errors.size(); i++)
+        {
+            if (errors[i])
+            {
+                for (SVGElement* shape : shapes)
+                {
+                    delete shape;
+                }
+                std::rethrow_exception(errors[i]);
+            }
+        }
+    }
 
-                polygon_elem->transform(transform,origin);
-                svg_elements.push_back(polygon_elem);
+    void readSVG(XMLDocument& doc, Point& dimensions, vector<SVGElement *>& svg_elements, int jobs)
+    {
+        TRACE_SCOPE("construct", "parse");
+        XMLElement *xml_elem = doc.RootElement();
 
-                if (id) id_map[id] = polygon_elem;
-            }
+        dimensions.x = xml_elem->IntAttribute("width");
+        dimensions.y = xml_elem->IntAttribute("height");
+        
+        /*Per each child node, an object should be dynamically allocated 
+        using new for the corresponding type of SVGElement, and be stored 
+        in the elements vector
+        To read colors use Color parse(std::string) function (see Color.hpp
+        /Color.cpp)
+        */
 
-            else if (elementType == "rect")   // If element is of type rectangle.
-            {
-                // Atributes needed for the rect constructor
-                Point top_left; int width, height;
-               
-                Color fill = parse_color(element->Attribute("fill"));
-            
-                top_left = {element->IntAttribute("x"),element->IntAttribute("y")};
-                width = element->IntAttribute("width");
-                height = element->IntAttribute("height");
-                
-                // Dynamically allocated rectangle object.
-                Rectangle* rect_elem = new Rectangle(top_left,width,height,fill);
-                
-                rect_elem->transform(transform,origin);
-                svg_elements.push_back(rect_elem);
+       // Shapes only depend on their own attributes, so they are built first,
+       // concurrently; groups, uses and ids are then resolved in document order.
+       vector<XMLElement*> shape_elements;
+       size_t work = 0;
+       collect_shape_elements(xml_elem, shape_elements, work);
+       GradientMap gradients = read_gradients(xml_elem, dimensions);
+       vector<SVGElement *> shapes;
+       readShapes(shape_elements, gradients, work, jobs, shapes);
 
-                if (id) id_map[id] = rect_elem;
-            }
-            
-            else if (elementType == "g")  // If element type is of type group.
+       //unordered map container used to correlate objects with their specific ids. 
+       std::unordered_map<std::string, SVGElement*> id_map;
+       size_t next_shape = 0;
+       readXMLElement(xml_elem,svg_elements,id_map,shapes,next_shape);
+    }
+    
+    void readXMLElement(XMLElement* xml_elem,vector<SVGElement *>& svg_elements,std::unordered_map<std::string, SVGElement*> id_map,
+                        const vector<SVGElement *>& shapes, size_t& next_shape){
+        TRACE_SCOPE("readXMLElement", "parse");
+
+        // Iterates over the Child nodes.
+        for (XMLElement* element = xml_elem->FirstChildElement(); element != nullptr; element = element->NextSiblingElement()) {
+            // Name of the svg element.
+            std::string elementType = element->Name();
+            // If there is none, "transform" will be nullpointer.
+            const char* transform = element->Attribute("transform");
+            // If there is none, "origin" will be nullpointer.
+            const char* origin = element->Attribute("transform-origin"); 
+            // If there is none, "id" will be nullpointer. 
+            const char* id = element->Attribute("id");
+            // Group and use opacity.
+            double opacity = element->DoubleAttribute("opacity", 1.0);
+
+            if (elementType == "g")  // If element type is of type group.
             {
                 // Atributes needed for the rect constructor.
                 std::vector<SVGElement *> group_elements;
                 // Call recursively readXMLElement for elements inside the group.
-                readXMLElement(element,group_elements,id_map);
+                readXMLElement(element,group_elements,id_map,shapes,next_shape);
 
                 // Dynamcally allocated Group object.
                 Group* group_elem = new Group(group_elements);
                 
+                group_elem->set_opacity(opacity);
                 group_elem->transform(transform,origin);
                 svg_elements.push_back(group_elem);
 
@@ -215,11 +516,21 @@ namespace svg
                 SVGElement* reference_element = id_map[reference];
 
                 SVGElement* clone_element = reference_element->clone();
+                clone_element->set_opacity(clone_element->get_opacity() * opacity);
                 clone_element->transform(transform, origin);
                 svg_elements.push_back(clone_element);
 
                 if (id) id_map[id] = clone_element;
             }
+
+            else   // Shapes, already built by readShapes.
+            {
+                SVGElement* shape = shapes[next_shape++];
+                if (shape == nullptr) continue;
+                svg_elements.push_back(shape);
+
+                if (id) id_map[id] = shape;
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,17 @@
+#include "SVGGenerator.hpp"
+#include <fstream>
+#include <iostream>
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::cout << "Usage: svggen key=value[,key=value...] out_file.svg" << std::endl
+                  << "Keys: width, height, polygons, vertices, copies, circles, depth, uses, opacity, seed" << std::endl;
+        return 1;
+    }
+    svg::SynthParams params = svg::parse_synth_params(argv[1]);
+    std::ofstream out(argv[2]);
+    svg::generate_svg(params, out);
+    return 0;
+}
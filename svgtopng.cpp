@@ -1,17 +1,236 @@
 #include "SVGElements.hpp"
+#include "Optimize.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Lists the SVG files of a directory, sorted by name.
+static std::vector<std::string> list_svg_files(const std::string &dir_path)
+{
+    std::vector<std::string> names;
+    ::DIR *directory = ::opendir(dir_path.c_str());
+    if (directory == nullptr)
+    {
+        return names;
+    }
+    ::dirent *entry;
+    while ((entry = ::readdir(directory)) != nullptr)
+    {
+        std::string fname = entry->d_name;
+        if (fname.size() > 4 && fname.compare(fname.size() - 4, 4, ".svg") == 0)
+        {
+            names.push_back(fname.substr(0, fname.size() - 4));
+        }
+    }
+    ::closedir(directory);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+// Parses an output spec, file.png[:scale=S][:region=x,y,w,h][:format=rgb|gray].
+static bool parse_output_spec(const std::string &text, svg::OutputSpec &spec)
+{
+    size_t end = text.find(':');
+    spec.png_file = text.substr(0, end);
+    while (end != std::string::npos)
+    {
+        size_t start = end + 1;
+        end = text.find(':', start);
+        std::string field = text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        size_t eq = field.find('=');
+        std::string key = field.substr(0, eq), value = eq == std::string::npos ? "" : field.substr(eq + 1);
+        if (key == "scale" && !value.empty())
+        {
+            spec.scale = std::atof(value.c_str());
+        }
+        else if (key == "region" && std::sscanf(value.c_str(), "%lf,%lf,%lf,%lf", &spec.region_x, &spec.region_y,
+                                                &spec.region_width, &spec.region_height) == 4)
+        {
+        }
+        else if (key == "format" && (value == "rgb" || value == "gray"))
+        {
+            spec.format = value == "gray" ? svg::PixelFormat::Gray : svg::PixelFormat::RGB;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return !spec.png_file.empty() && spec.scale > 0;
+}
 
 int main(int argc, char **argv)
 {
-    if (argc != 3)
+    svg::RenderOptions options;
+    svg::TileOptions tile_options;
+    svg::BatchOptions batch_options;
+    std::vector<svg::OutputSpec> outputs;
+    // --scale or --region given (not allowed with --output).
+    bool view_set = false;
+    bool tiles = false, batch = false;
+    // Options come before the file names.
+    int i = 1;
+    for (; i < argc && std::string(argv[i]).compare(0, 2, "--") == 0; i++)
+    {
+        std::string opt = argv[i];
+        if (opt == "--trace" && i + 1 < argc)
+        {
+            svg::trace::start(argv[++i]);
+        }
+        else if (opt == "--aa")
+        {
+            options.antialiasing = true;
+        }
+        else if (opt == "--scale" && i + 1 < argc)
+        {
+            options.scale = std::atof(argv[++i]);
+            view_set = true;
+        }
+        else if (opt == "--region" && i + 1 < argc &&
+                 std::sscanf(argv[i + 1], "%lf,%lf,%lf,%lf", &options.region_x, &options.region_y,
+                             &options.region_width, &options.region_height) == 4)
+        {
+            i++;
+            view_set = true;
+        }
+        else if (opt == "--min-size" && i + 1 < argc)
+        {
+            options.min_size = std::atof(argv[++i]);
+        }
+        else if (opt == "--share-geometry")
+        {
+            options.share_geometry = true;
+        }
+        else if (opt == "--optimize")
+        {
+            options.optimize = true;
+        }
+        else if (opt == "--mmap")
+        {
+            options.storage = svg::PixelStorage::File;
+        }
+        else if (opt == "--output" && i + 1 < argc)
+        {
+            outputs.emplace_back();
+            if (!parse_output_spec(argv[++i], outputs.back()))
+            {
+                argc = 0;
+                break;
+            }
+        }
+        else if (opt == "--tiles")
+        {
+            tiles = true;
+        }
+        else if (opt == "--batch")
+        {
+            batch = true;
+        }
+        else if (opt == "--load-jobs" && i + 1 < argc)
+        {
+            batch_options.load_jobs = std::atoi(argv[++i]);
+        }
+        else if (opt == "--raster-jobs" && i + 1 < argc)
+        {
+            batch_options.raster_jobs = std::atoi(argv[++i]);
+        }
+        else if (opt == "--encode-jobs" && i + 1 < argc)
+        {
+            batch_options.encode_jobs = std::atoi(argv[++i]);
+        }
+        else if (opt == "--queue-depth" && i + 1 < argc)
+        {
+            batch_options.queue_depth = std::atoi(argv[++i]);
+        }
+        else if (opt == "--tile-size" && i + 1 < argc)
+        {
+            tile_options.tile_size = std::atoi(argv[++i]);
+        }
+        else if (opt == "--jobs" && i + 1 < argc)
+        {
+            options.jobs = tile_options.jobs = std::atoi(argv[++i]);
+        }
+        else
+        {
+            argc = 0;
+            break;
+        }
+    }
+    if (!outputs.empty() && view_set)
+    {
+        // Each output has its own scale and region.
+        std::cerr << "--scale and --region cannot be combined with --output, use :scale= and :region= instead" << std::endl;
+        return 1;
+    }
+    if (argc - i != (outputs.empty() ? 2 : 1))
+    {
+        std::cout << "Usage: svgtopng [--trace trace.json] [--aa] [--scale S] [--region x,y,w,h] [--min-size N]"
+                  << " [--share-geometry] [--optimize] [--mmap] [--jobs N] in_file.svg out_file.png" << std::endl
+                  << "       svgtopng --tiles [--trace trace.json] [--aa] [--min-size N] [--share-geometry] [--tile-size N] [--jobs N]"
+                  << " in_file.svg out_dir" << std::endl
+                  << "       svgtopng --batch [--aa] [--scale S] [--min-size N] [--share-geometry] [--optimize] [--mmap] [--load-jobs N]"
+                  << " [--raster-jobs N] [--encode-jobs N] [--queue-depth N] in_dir out_dir" << std::endl
+                  << "       svgtopng [--aa] [--min-size N] [--share-geometry] [--optimize] [--jobs N]"
+                  << " --output out.png[:scale=S][:region=x,y,w,h][:format=rgb|gray] [--output ...] in_file.svg" << std::endl;
+    }
+    else if (!outputs.empty())
+    {
+        std::cout << "Performing conversion ... " << argv[i] << " --> " << outputs.size() << " outputs" << std::endl;
+        svg::convert(argv[i], outputs, options);
+        std::cout << "Done!" << std::endl;
+    }
+    else if (batch)
+    {
+        // One construction thread per file; the pipeline stages provide the parallelism.
+        batch_options.render = options;
+        batch_options.render.jobs = 1;
+        std::string in_dir = argv[i], out_dir = argv[i + 1];
+        std::vector<std::string> names = list_svg_files(in_dir), svg_files, png_files, errors;
+        for (const std::string &name : names)
+        {
+            svg_files.push_back(in_dir + "/" + name + ".svg");
+            png_files.push_back(out_dir + "/" + name + ".png");
+        }
+        ::mkdir(out_dir.c_str(), 0755);
+        std::cout << "Converting " << svg_files.size() << " files ... " << in_dir << " --> " << out_dir << std::endl;
+        int count = svg::convert_batch(svg_files, png_files, batch_options, errors);
+        for (const std::string &error : errors)
+        {
+            if (!error.empty())
+            {
+                std::cerr << error << std::endl;
+            }
+        }
+        std::cout << "Done! " << count << " files" << std::endl;
+        return count == (int)svg_files.size() ? 0 : 1;
+    }
+    else if (tiles)
     {
-        std::cout << "Usage: svgtopng in_file.svg out_file.png" << std::endl;
+        tile_options.render = options;
+        std::cout << "Rendering tiles ... " << argv[i] << " --> " << argv[i + 1] << std::endl;
+        int count = svg::render_tiles(argv[i], argv[i + 1], tile_options);
+        std::cout << "Done! " << count << " tiles" << std::endl;
     }
     else
     {
-        std::cout << "Performing conversion ... " << argv[1] << " --> " << argv[2] << std::endl;
-        svg::convert(argv[1], argv[2]);
+        std::cout << "Performing conversion ... " << argv[i] << " --> " << argv[i + 1] << std::endl;
+        svg::OptimizeStats stats;
+        svg::convert(argv[i], argv[i + 1], options, &stats);
+        if (options.optimize)
+        {
+            std::cout << "Optimized: " << stats.groups_flattened << " groups flattened, removed "
+                      << stats.empty_removed << " empty, " << stats.offscreen_removed << " off-image and "
+                      << stats.covered_removed << " covered shapes, " << stats.batched << " polygons drawn in "
+                      << stats.batches << " batches" << std::endl;
+        }
         std::cout << "Done!" << std::endl;
     }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,9 @@
 
 // Project file headers
 #include "SVGElements.hpp"
+#include "SceneIndex.hpp"
+#include "RenderContext.hpp"
+#include "external/tinyxml2/tinyxml2.h"
 
 // C++ library headers
 #include <algorithm>
@@ -12,17 +15,361 @@
 #include <vector>
 #include <iterator>
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <map>
+#include <stdexcept>
 using namespace std;
 
 // POSIX headers
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <dirent.h>
 
 namespace svg
 {
     const string LOG_FILE_NAME = "test_log.txt";
+    const string PERF_BASELINE_FILE = "perf_baseline.txt";
+    //! Expected images of the tests rendered with anti-aliasing (test --aa),
+    //! below the root path. Only the tests with an image there are run.
+    const string AA_EXPECTED_DIR = "expected/aa";
+
+    //! Tests of the library API that are not the conversion of one input
+    //! file. They run like conversion tests, one child process each, and
+    //! print what failed.
+    namespace api_tests
+    {
+        bool check(bool ok, const string &what)
+        {
+            if (!ok)
+            {
+                cout << "Check failed: " << what << endl;
+            }
+            return ok;
+        }
+
+        //! Read the elements of an SVG document given as text.
+        void read_elements(const char *svg, vector<SVGElement *> &elements)
+        {
+            tinyxml2::XMLDocument doc;
+            doc.Parse(svg);
+            Point dimensions;
+            readSVG(doc, dimensions, elements);
+        }
+
+        //! Read a whole file.
+        //! @return Its contents (empty if it cannot be read).
+        string read_file(const string &path)
+        {
+            ifstream in(path.c_str(), ios::binary);
+            ostringstream contents;
+            contents << in.rdbuf();
+            return contents.str();
+        }
+
+        FixedPoint at(int x, int y)
+        {
+            return {to_fixed(x), to_fixed(y)};
+        }
+
+        //! convert_batch: each file is the same as the one written by convert,
+        //! and a missing or malformed input only fails its own entry.
+        bool batch(const string &root_path, const RenderOptions &render)
+        {
+            const char *names[] = {"group_1", "lion", "missing", "polyline_3", "malformed", "rect_1", "use_2"};
+            string malformed = root_path + "/output/api_batch_malformed.svg";
+            ofstream(malformed.c_str()) << "<svg width='10' height='10'><rect";
+            vector<string> svg_files, png_files;
+            for (const char *name : names)
+            {
+                string id = name;
+                svg_files.push_back(id == "missing"     ? root_path + "/input/missing_file.svg"
+                                    : id == "malformed" ? malformed
+                                                        : root_path + "/input/" + id + ".svg");
+                png_files.push_back(root_path + "/output/api_batch_" + id + ".png");
+            }
+            BatchOptions options;
+            options.render = render;
+            options.load_jobs = 2;
+            options.raster_jobs = 3;
+            options.encode_jobs = 2;
+            options.queue_depth = 1;
+            vector<string> errors;
+            int converted = convert_batch(svg_files, png_files, options, errors);
+            bool ok = check(converted == 5, "5 files converted, got " + to_string(converted));
+            ok = check(errors.size() == svg_files.size(), "one error entry per file") && ok;
+            for (size_t i = 0; ok && i < svg_files.size(); i++)
+            {
+                string id = names[i];
+                if (id == "missing" || id == "malformed")
+                {
+                    ok = check(!errors[i].empty(), id + " reported") && ok;
+                    continue;
+                }
+                ok = check(errors[i].empty(), id + " converted: " + errors[i]) && ok;
+                string single = root_path + "/output/api_batch_" + id + "_single.png";
+                convert(svg_files[i], single, render);
+                string expected = read_file(single);
+                ok = check(!expected.empty() && read_file(png_files[i]) == expected, id + " same as convert") && ok;
+            }
+            return ok;
+        }
+
+        //! Multi-output convert: each output is the same as the file written
+        //! by a single-output convert with its scale and region (and, for gray
+        //! outputs, the same image saved as gray).
+        bool multi_output(const string &root_path, const RenderOptions &render)
+        {
+            string svg_file = root_path + "/input/lion.svg";
+            vector<OutputSpec> outputs(4);
+            outputs[1].scale = 0.5;
+            outputs[2].scale = 2;
+            outputs[2].region_x = 330;
+            outputs[2].region_y = 80;
+            outputs[2].region_width = 150;
+            outputs[2].region_height = 120;
+            outputs[3].scale = 1.5;
+            outputs[3].format = PixelFormat::Gray;
+            for (size_t i = 0; i < outputs.size(); i++)
+            {
+                outputs[i].png_file = root_path + "/output/api_multi_output_" + to_string(i) + ".png";
+            }
+            RenderOptions options = render;
+            options.jobs = 2;
+            convert(svg_file, outputs, options);
+            bool ok = true;
+            for (size_t i = 0; i < outputs.size(); i++)
+            {
+                const OutputSpec &spec = outputs[i];
+                RenderOptions single_options = render;
+                single_options.scale = spec.scale;
+                single_options.region_x = spec.region_x;
+                single_options.region_y = spec.region_y;
+                single_options.region_width = spec.region_width;
+                single_options.region_height = spec.region_height;
+                string single = root_path + "/output/api_multi_output_" + to_string(i) + "_single.png";
+                convert(svg_file, single, single_options);
+                if (spec.format == PixelFormat::Gray)
+                {
+                    PNGImage(single).save(single, PixelFormat::Gray);
+                }
+                string expected = read_file(single);
+                ok = check(!expected.empty() && read_file(spec.png_file) == expected,
+                           "output " + to_string(i) + " same as convert") && ok;
+            }
+            return ok;
+        }
+
+        //! RenderContext: going from a large document to a small one and then
+        //! to a larger one (with and without the optimizer, whose polygon
+        //! batches use their own buffer), every file is the same as the one
+        //! written by a fresh convert.
+        bool render_context(const string &root_path, const RenderOptions &render)
+        {
+            const char *names[] = {"lion", "group_1", "rect_3", "batman", "path_1", "stroke_1"};
+            RenderContext context;
+            bool ok = true;
+            for (bool optimize : {false, true})
+            {
+                RenderOptions options = render;
+                options.optimize = options.optimize || optimize;
+                for (const char *name : names)
+                {
+                    string id = name;
+                    string svg_file = root_path + "/input/" + id + ".svg";
+                    string png_file = root_path + "/output/api_render_context_" + id + ".png";
+                    string single = root_path + "/output/api_render_context_" + id + "_single.png";
+                    context.convert(svg_file, png_file, options);
+                    convert(svg_file, single, options);
+                    string expected = read_file(single);
+                    ok = check(!expected.empty() && read_file(png_file) == expected,
+                               id + (optimize ? " (optimized)" : "") + " same as convert") && ok;
+                }
+            }
+            return ok;
+        }
+
+        //! render_tiles: the tiles of the largest level are crops of the image
+        //! written by convert, and a tile that cannot be written makes the call
+        //! throw once all threads are done.
+        bool tiles(const string &root_path, const RenderOptions &render)
+        {
+            const char *names[] = {"lion", "group_6", "opacity_1", "optimize_1"};
+            TileOptions options;
+            options.render = render;
+            options.tile_size = 64;
+            options.jobs = 3;
+            bool ok = true;
+            for (const char *name : names)
+            {
+                string id = name;
+                string svg_file = root_path + "/input/" + id + ".svg";
+                string out_dir = root_path + "/output/api_tiles_" + id;
+                string single = root_path + "/output/api_tiles_" + id + "_single.png";
+                render_tiles(svg_file, out_dir, options);
+                convert(svg_file, single, render);
+                PNGImage full(single);
+                int max_zoom = 0;
+                while (options.tile_size << max_zoom < max(full.width(), full.height()))
+                {
+                    max_zoom++;
+                }
+                bool same = true;
+                for (int x0 = 0; x0 < full.width(); x0 += options.tile_size)
+                {
+                    for (int y0 = 0; y0 < full.height(); y0 += options.tile_size)
+                    {
+                        PNGImage tile(out_dir + "/" + to_string(max_zoom) + "/" + to_string(x0 / options.tile_size) +
+                                      "/" + to_string(y0 / options.tile_size) + ".png");
+                        same = same && tile.width() == min(options.tile_size, full.width() - x0) &&
+                               tile.height() == min(options.tile_size, full.height() - y0);
+                        for (int y = 0; same && y < tile.height(); y++)
+                        {
+                            for (int x = 0; same && x < tile.width(); x++)
+                            {
+                                Color a = tile.at(x, y), b = full.at(x0 + x, y0 + y);
+                                same = a.red == b.red && a.green == b.green && a.blue == b.blue;
+                            }
+                        }
+                    }
+                }
+                ok = check(same, id + " tiles of level " + to_string(max_zoom) + " are crops of convert") && ok;
+            }
+
+            // A directory in place of the level 0 tile.
+            string out_dir = root_path + "/output/api_tiles_error";
+            for (const string &dir : {out_dir, out_dir + "/0", out_dir + "/0/0", out_dir + "/0/0/0.png"})
+            {
+                ::mkdir(dir.c_str(), 0755);
+            }
+            bool threw = false;
+            try
+            {
+                render_tiles(root_path + "/input/lion.svg", out_dir, options);
+            }
+            catch (const runtime_error &)
+            {
+                threw = true;
+            }
+            return check(threw, "unwritable tile reported") && ok;
+        }
+
+        //! SceneIndex: topmost hits in paint order, exact containment (also
+        //! of paths), and rectangle queries spanning several grid cells.
+        bool scene_index(const string &, const RenderOptions &)
+        {
+            vector<SVGElement *> e;
+            read_elements("<svg width='300' height='300'>"
+                          "<rect x='0' y='0' width='300' height='300' fill='white'/>"
+                          "<circle cx='50' cy='50' r='10' fill='red'/>"
+                          "<circle cx='150' cy='50' r='10' fill='red'/>"
+                          "<circle cx='250' cy='50' r='10' fill='red'/>"
+                          "<circle cx='50' cy='150' r='10' fill='red'/>"
+                          "<circle cx='150' cy='150' r='10' fill='red'/>"
+                          "<circle cx='250' cy='150' r='10' fill='red'/>"
+                          "<circle cx='50' cy='250' r='10' fill='red'/>"
+                          "<circle cx='150' cy='250' r='10' fill='red'/>"
+                          "<circle cx='250' cy='250' r='10' fill='red'/>"
+                          "<polygon points='200,200 290,200 200,290' fill='blue'/>"
+                          "<ellipse cx='150' cy='150' rx='40' ry='20' fill='green'/>"
+                          "</svg>",
+                          e);
+            bool ok = check(e.size() == 12, "12 elements read");
+            if (ok)
+            {
+                SceneIndex index(e);
+                ok = check(index.size() == 12, "12 shapes indexed") && ok;
+                // The ellipse is painted over the circle at the same center.
+                ok = check(index.element_at(at(150, 150)) == e[11], "topmost of overlapping shapes") && ok;
+                ok = check(index.element_at(at(50, 50)) == e[1], "circle over the background") && ok;
+                ok = check(index.element_at(at(10, 10)) == e[0], "background") && ok;
+                // Within the bounding boxes, but outside the shapes.
+                ok = check(index.element_at(at(280, 280)) == e[0], "point outside the triangle") && ok;
+                ok = check(index.element_at(at(210, 210)) == e[10], "point inside the triangle") && ok;
+                ok = check(index.element_at(at(185, 165)) == e[0], "point outside the ellipse") && ok;
+                ok = check(index.element_at(at(-50, -50)) == nullptr, "point outside the scene") && ok;
+
+                vector<const SVGElement *> found;
+                index.query({to_fixed(-10), to_fixed(-10), to_fixed(310), to_fixed(310)}, found);
+                ok = check(found == vector<const SVGElement *>(e.begin(), e.end()), "query of the whole scene") && ok;
+                index.query({to_fixed(40), to_fixed(40), to_fixed(160), to_fixed(60)}, found);
+                ok = check(found == vector<const SVGElement *>{e[0], e[1], e[2]}, "query of a row of cells") && ok;
+                index.query({to_fixed(70), to_fixed(70), to_fixed(80), to_fixed(80)}, found);
+                ok = check(found == vector<const SVGElement *>{e[0]}, "query between shapes") && ok;
+            }
+            for (SVGElement *element : e)
+            {
+                delete element;
+            }
+
+            // Paths with two contours and one, hit in turn: each test reuses
+            // the contours flattened by the one before.
+            vector<SVGElement *> paths;
+            read_elements("<svg width='200' height='100'>"
+                          "<path d='M 10 10 L 90 10 L 90 90 L 10 90 Z M 30 30 L 70 30 L 70 70 L 30 70 Z'"
+                          " fill-rule='evenodd' fill='red'/>"
+                          "<path d='M 110 50 C 110 0 190 0 190 50 C 190 100 110 100 110 50 Z' fill='blue'/>"
+                          "</svg>",
+                          paths);
+            if (check(paths.size() == 2, "2 paths read"))
+            {
+                SceneIndex index(paths);
+                for (int round = 0; round < 2; round++)
+                {
+                    ok = check(index.element_at(at(20, 20)) == paths[0], "point inside the outer contour") && ok;
+                    ok = check(index.element_at(at(50, 50)) == nullptr, "point inside the hole") && ok;
+                    ok = check(index.element_at(at(150, 50)) == paths[1], "point inside the curves") && ok;
+                    ok = check(index.element_at(at(112, 15)) == nullptr, "point outside the curves") && ok;
+                }
+            }
+            for (SVGElement *element : paths)
+            {
+                delete element;
+            }
+            return ok;
+        }
+    }
+
+    //! API test (see api_tests), selected by id like the conversion tests.
+    struct ApiTest
+    {
+        const char *id;
+        //! Run the test with the driver's root path and conversion options.
+        bool (*run)(const string &root_path, const RenderOptions &render);
+    };
+    const ApiTest API_TESTS[] = {
+        {"api_batch", api_tests::batch},
+        {"api_multi_output", api_tests::multi_output},
+        {"api_render_context", api_tests::render_context},
+        {"api_scene_index", api_tests::scene_index},
+        {"api_tiles", api_tests::tiles}};
+
+    const ApiTest *find_api_test(const string &id)
+    {
+        for (const ApiTest &test : API_TESTS)
+        {
+            if (id == test.id)
+            {
+                return &test;
+            }
+        }
+        return nullptr;
+    }
+
+    //! Conversion timing options (see TestDriver::set_perf_options).
+    struct PerfOptions
+    {
+        //! Timed conversions per test, after the checked one (0: no timing).
+        int reps = 0;
+        //! Allowed slowdown over the baseline median, in percent.
+        double threshold = 25;
+        //! Fail regressed tests instead of warning.
+        bool fail = false;
+        //! Write the measured medians to the baseline file.
+        bool update = false;
+    };
 
     class TestDriver
     {
@@ -31,14 +378,110 @@ namespace svg
         int total_tests = 0;
         int passed_tests = 0;
         int failed_tests = 0;
+        int jobs;
         FILE *log_stream;
+        PerfOptions perf;
+        //! Conversion options (e.g. optimize), which must not change the images.
+        RenderOptions render;
+        //! Baseline timing of a test.
+        struct BaselineEntry
+        {
+            //! Median conversion time, in milliseconds.
+            double median_ms;
+            //! Calibration time measured with it (0: not recorded).
+            double calibration_ms;
+        };
+        map<string, BaselineEntry> baseline;
+        //! Calibration time of this run (see calibrate).
+        double calibration_ms = 0;
+        int perf_regressions = 0;
+
+        string baseline_path() const
+        {
+            return root_path + "/" + PERF_BASELINE_FILE;
+        }
+
+        //! Read the baseline file: one "test median_ms calibration_ms" line
+        //! per test (lines without the calibration time are compared as is).
+        void load_baseline()
+        {
+            ifstream in(baseline_path().c_str());
+            string line;
+            while (getline(in, line))
+            {
+                istringstream fields(line);
+                string id;
+                BaselineEntry entry = {0, 0};
+                if (fields >> id >> entry.median_ms)
+                {
+                    fields >> entry.calibration_ms;
+                    baseline[id] = entry;
+                }
+            }
+        }
+
+        void save_baseline() const
+        {
+            ofstream out(baseline_path().c_str());
+            out << fixed << setprecision(3);
+            for (const auto &entry : baseline)
+            {
+                out << entry.first << ' ' << entry.second.median_ms << ' ' << entry.second.calibration_ms << endl;
+            }
+        }
+
+        //! Time a fixed workload that does not depend on the renderer (sorting
+        //! pseudo-random numbers), to scale the baseline to the speed of this
+        //! machine.
+        //! @return The median time in milliseconds.
+        static double calibrate()
+        {
+            vector<unsigned> values(1 << 20);
+            vector<double> ms;
+            for (int r = 0; r < 7; r++)
+            {
+                unsigned seed = 12345;
+                for (unsigned &value : values)
+                {
+                    seed = seed * 1103515245u + 12345u;
+                    value = seed;
+                }
+                auto start = chrono::steady_clock::now();
+                sort(values.begin(), values.end());
+                ms.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+            }
+            sort(ms.begin(), ms.end());
+            return ms[ms.size() / 2];
+        }
+
+        //! Time perf.reps conversions of a test.
+        //! @return The median time in milliseconds.
+        double time_conversion(const string &id)
+        {
+            string svg_file = root_path + "/input/" + id + ".svg";
+            string out_file = root_path + "/output/" + id + ".png";
+            vector<double> ms;
+            for (int r = 0; r < perf.reps; r++)
+            {
+                auto start = chrono::steady_clock::now();
+                convert(svg_file, out_file, render);
+                ms.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+            }
+            sort(ms.begin(), ms.end());
+            return ms[ms.size() / 2];
+        }
+
+        string expected_file(const string &id) const
+        {
+            return root_path + "/" + (render.antialiasing ? AA_EXPECTED_DIR : "expected") + "/" + id + ".png";
+        }
 
         bool run_conversion_test(const string &id)
         {
             string svg_file = root_path + "/input/" + id + ".svg";
-            string exp_file = root_path + "/expected/" + id + ".png";
+            string exp_file = expected_file(id);
             string out_file = root_path + "/output/" + id + ".png";
-            convert(svg_file, out_file);
+            convert(svg_file, out_file, render);
             PNGImage img1(exp_file), img2(out_file);
             int w1 = img1.width(), h1 = img1.height(),
                 w2 = img2.width(), h2 = img2.height();
@@ -67,50 +510,65 @@ namespace svg
             return true;
         }
 
-        void onTestBegin(const string &id)
+        //! State of a single test run (one forked child process).
+        struct TestRun
         {
-            total_tests++;
-            fprintf(log_stream, ">>>> [%d] %s <<<<\n", total_tests, id.c_str());
-            fflush(log_stream);
-            cout << '[' << total_tests << "] " << id << ": ";
-            cout.flush();
-        }
-        void onTestCompletion(bool success)
+            //! Test identifier.
+            string id;
+            //! Child process id (-1 while not started).
+            ::pid_t pid = -1;
+            //! Temporary file holding the child's stdout/stderr.
+            FILE *log = nullptr;
+            //! Temporary file receiving the child's median conversion time.
+            FILE *timing = nullptr;
+            //! Median conversion time in milliseconds (negative if not timed).
+            double median_ms = -1;
+            //! Launch time.
+            chrono::steady_clock::time_point start;
+            //! Wall time in milliseconds (from fork to child exit).
+            double wall_ms = 0;
+            //! True once the child has been reaped.
+            bool done = false;
+            //! Test outcome.
+            bool success = false;
+        };
+
+        void launch_test(TestRun &run)
         {
-            cout << (success ? "pass" : "fail") << std::endl;
-            if (success)
+            run.log = ::tmpfile();
+            if (run.log == nullptr)
             {
-                passed_tests++;
+                perror("Unable to run tests! Could not create temporary log file!");
+                ::exit(1);
             }
-            else
+            const ApiTest *api_test = find_api_test(run.id);
+            if (perf.reps > 0 && api_test == nullptr && (run.timing = ::tmpfile()) == nullptr)
             {
-                failed_tests++;
+                perror("Unable to run tests! Could not create temporary timing file!");
+                ::exit(1);
             }
-        }
-
-        void run_test(const string& id)
-        {
-            int log_fd = ::fileno(log_stream);
-            onTestBegin(id);
+            fflush(log_stream);
+            cout.flush();
+            run.start = chrono::steady_clock::now();
             ::pid_t pid = ::fork();
 
             if (pid == 0)
             {
-            
+                int log_fd = ::fileno(run.log);
                 ::dup2(log_fd, 1);
                 ::dup2(log_fd, 2);
-                bool success = run_conversion_test(id);
+                bool success = api_test != nullptr ? api_test->run(root_path, render) : run_conversion_test(run.id);
+                // The checked conversion doubles as a warm-up for the timed ones.
+                if (success && run.timing != nullptr)
+                {
+                    fprintf(run.timing, "%f\n", time_conversion(run.id));
+                    fflush(run.timing);
+                }
                 ::exit(success ? 0 : 1);
             }
             else if (pid > 0)
             {
-                // parent process waits
-                int child_status = -1;
-                ::waitpid(pid, &child_status, 0);
-
-                bool success = WIFEXITED(child_status) &&
-                               WEXITSTATUS(child_status) == 0;
-                onTestCompletion(success);
+                run.pid = pid;
             }
             else
             {
@@ -120,13 +578,161 @@ namespace svg
             }
         }
 
+        void onTestCompletion(TestRun &run)
+        {
+            total_tests++;
+            fprintf(log_stream, ">>>> [%d] %s <<<<\n", total_tests, run.id.c_str());
+            // Copy the child's output into the log section for this test.
+            ::rewind(run.log);
+            char buf[4096];
+            size_t n;
+            while ((n = ::fread(buf, 1, sizeof(buf), run.log)) > 0)
+            {
+                ::fwrite(buf, 1, n, log_stream);
+            }
+            ::fclose(run.log);
+            run.log = nullptr;
+            string perf_note = check_timing(run);
+            fflush(log_stream);
+
+            cout << '[' << total_tests << "] " << run.id << ": "
+                 << (run.success ? "pass" : "fail")
+                 << " (" << fixed << setprecision(1) << run.wall_ms << " ms" << perf_note << ")" << std::endl;
+            if (run.success)
+            {
+                passed_tests++;
+            }
+            else
+            {
+                failed_tests++;
+            }
+        }
+
+        //! Compare the median time of a run with the baseline (or record it),
+        //! failing the run on regressions if requested.
+        //! @return Note for the result line.
+        string check_timing(TestRun &run)
+        {
+            if (run.timing == nullptr)
+            {
+                return "";
+            }
+            ::rewind(run.timing);
+            if (fscanf(run.timing, "%lf", &run.median_ms) != 1)
+            {
+                run.median_ms = -1;
+            }
+            ::fclose(run.timing);
+            run.timing = nullptr;
+            if (run.median_ms < 0)
+            {
+                return "";
+            }
+            ostringstream note;
+            note << fixed << setprecision(1) << ", median " << run.median_ms << " ms";
+            auto base = baseline.find(run.id);
+            if (perf.update)
+            {
+                baseline[run.id] = {run.median_ms, calibration_ms};
+            }
+            else if (base != baseline.end())
+            {
+                // Scale the baseline by how much faster or slower this machine
+                // runs the calibration workload than the one that recorded it.
+                double expected_ms = base->second.median_ms;
+                if (base->second.calibration_ms > 0)
+                {
+                    expected_ms *= calibration_ms / base->second.calibration_ms;
+                }
+                double change = 100.0 * (run.median_ms / expected_ms - 1.0);
+                note << showpos << " " << change << "%" << noshowpos;
+                if (change > perf.threshold)
+                {
+                    perf_regressions++;
+                    note << " SLOWER than baseline " << expected_ms << " ms";
+                    fprintf(log_stream, "Performance regression: median %.1f ms, baseline %.1f ms (threshold %+.0f%%)\n",
+                            run.median_ms, expected_ms, perf.threshold);
+                    if (perf.fail)
+                    {
+                        run.success = false;
+                    }
+                }
+            }
+            return note.str();
+        }
+
+        //! Wait for any running child and record its result.
+        void reap_one(vector<TestRun> &runs)
+        {
+            int child_status = -1;
+            ::pid_t pid = ::waitpid(-1, &child_status, 0);
+            if (pid < 0)
+            {
+                perror("Unable to run tests! waitpid failed!");
+                ::exit(1);
+            }
+            for (TestRun &run : runs)
+            {
+                if (run.pid == pid && !run.done)
+                {
+                    run.wall_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - run.start).count();
+                    run.success = WIFEXITED(child_status) &&
+                                  WEXITSTATUS(child_status) == 0;
+                    run.done = true;
+                    return;
+                }
+            }
+        }
+
+        void print_slowest(const vector<TestRun> &runs, size_t count)
+        {
+            vector<const TestRun *> by_time;
+            for (const TestRun &run : runs)
+            {
+                by_time.push_back(&run);
+            }
+            sort(by_time.begin(), by_time.end(),
+                 [](const TestRun *a, const TestRun *b)
+                 { return a->wall_ms > b->wall_ms; });
+            count = min(count, by_time.size());
+            cout << "Slowest tests:" << endl;
+            for (size_t i = 0; i < count; i++)
+            {
+                cout << "  " << fixed << setprecision(1) << setw(9)
+                     << by_time[i]->wall_ms << " ms  " << by_time[i]->id << endl;
+            }
+        }
+
     public:
-        TestDriver(const string &root_path)
+        //! Constructor.
+        //! @param root_path Directory containing input/, expected/ and output/.
+        //! @param jobs Maximum number of tests running concurrently.
+        TestDriver(const string &root_path, int jobs = 1)
             : root_path(root_path),
+              jobs(max(jobs, 1)),
               log_stream(fopen((root_path + "/" + LOG_FILE_NAME).c_str(), "w"))
         {
         }
 
+        //! Enable conversion timing against the baseline file, calibrating
+        //! the speed of this machine first.
+        //! @param options Timing options.
+        void set_perf_options(const PerfOptions &options)
+        {
+            perf = options;
+            load_baseline();
+            calibration_ms = calibrate();
+        }
+
+        //! Set the conversion options; tests still compare with the same
+        //! expected images, except that anti-aliased renders are compared with
+        //! the ones in AA_EXPECTED_DIR.
+        //! @param options Rendering options.
+        void set_render_options(const RenderOptions &options)
+        {
+            render = options;
+        }
+
         void run_tests(const string &spec)
         {
             string dir_path = root_path + "/input";
@@ -143,13 +749,23 @@ namespace svg
                 if (entry->d_type == DT_REG)
                 {
                     string fname = entry->d_name;
-                    if (fname.find(spec) == 0)
+                    string id = fname.substr(0, fname.find_last_of('.'));
+                    if (fname.find(spec) == 0 &&
+                        (!render.antialiasing || ::access(expected_file(id).c_str(), R_OK) == 0))
                     {
-                        scripts_to_execute.push_back(fname.substr(0, fname.find_last_of('.')));
+                        scripts_to_execute.push_back(id);
                     }
                 }
             }
             ::closedir(directory);
+            // API tests do not depend on anti-aliasing.
+            for (const ApiTest &test : API_TESTS)
+            {
+                if (!render.antialiasing && string(test.id).find(spec) == 0)
+                {
+                    scripts_to_execute.push_back(test.id);
+                }
+            }
             if (scripts_to_execute.empty())
             {
                 cout << "No scripts matched the spec: " << spec << endl;
@@ -158,26 +774,132 @@ namespace svg
             sort(scripts_to_execute.begin(), scripts_to_execute.end());
 
             cout << "== " << scripts_to_execute.size() << " tests to execute  ==" << endl;
-            for (string id : scripts_to_execute)
+            vector<TestRun> runs(scripts_to_execute.size());
+            for (size_t i = 0; i < runs.size(); i++)
+            {
+                runs[i].id = scripts_to_execute[i];
+            }
+            auto suite_start = chrono::steady_clock::now();
+            size_t next = 0, reported = 0;
+            int running = 0;
+            while (reported < runs.size())
             {
-                run_test(id);
+                while (running < jobs && next < runs.size())
+                {
+                    launch_test(runs[next++]);
+                    running++;
+                }
+                reap_one(runs);
+                running--;
+                // Report finished tests in sorted order so that the console
+                // and log file do not depend on completion order.
+                while (reported < runs.size() && runs[reported].done)
+                {
+                    onTestCompletion(runs[reported++]);
+                }
             }
+            double suite_ms = chrono::duration<double, milli>(chrono::steady_clock::now() - suite_start).count();
 
             cout << "== TEST EXECUTION SUMMARY ==" << endl
                  << "Total tests: " << total_tests << endl
                  << "Passed tests: " << passed_tests << endl
                  << "Failed tests: " << failed_tests << endl
-                 << "See " << LOG_FILE_NAME << " for details." << endl;
+                 << "Wall time: " << fixed << setprecision(1) << suite_ms
+                 << " ms (" << jobs << " job" << (jobs > 1 ? "s" : "") << ")" << endl;
+            if (perf.reps > 0 && perf.update)
+            {
+                save_baseline();
+                cout << "Baseline written to " << baseline_path() << endl;
+            }
+            else if (perf.reps > 0)
+            {
+                cout << "Performance regressions: " << perf_regressions << " (threshold "
+                     << showpos << setprecision(0) << perf.threshold << noshowpos << "%" << (perf.fail ? ", failing" : ", warning only") << ")" << endl;
+            }
+            print_slowest(runs, 5);
+            cout << "See " << LOG_FILE_NAME << " for details." << endl;
         }
     };
 }
 
 int main(int argc, char **argv)
 {
-    --argc;
-    ++argv;
-    svg::TestDriver driver(argc == 2 ? argv[1] : ".");
-    string spec = argc >= 1 ? argv[0] : "";
+    // Usage: test [-j N] [--optimize] [--aa] [--perf-reps N [--threshold PCT] [--perf-fail] [--update-baseline]] [spec [root_path]]
+    int jobs = 1;
+    svg::PerfOptions perf;
+    svg::RenderOptions render;
+    vector<string> args;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc)
+        {
+            jobs = atoi(argv[++i]);
+        }
+        else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2)
+        {
+            jobs = atoi(arg.c_str() + 2);
+        }
+        else if (arg == "--optimize")
+        {
+            render.optimize = true;
+        }
+        else if (arg == "--aa")
+        {
+            render.antialiasing = true;
+        }
+        else if (arg == "--perf-reps" && i + 1 < argc)
+        {
+            perf.reps = atoi(argv[++i]);
+        }
+        else if (arg == "--threshold" && i + 1 < argc)
+        {
+            perf.threshold = atof(argv[++i]);
+        }
+        else if (arg == "--perf-fail")
+        {
+            perf.fail = true;
+        }
+        else if (arg == "--update-baseline")
+        {
+            perf.update = true;
+        }
+        else
+        {
+            args.push_back(arg);
+        }
+    }
+    if (jobs < 1)
+    {
+        cerr << "Invalid number of jobs, expected -j N with N >= 1" << endl;
+        return 1;
+    }
+    if ((perf.fail || perf.update) && perf.reps < 1)
+    {
+        cerr << "--perf-fail and --update-baseline need --perf-reps N with N >= 1" << endl;
+        return 1;
+    }
+    if (perf.reps > 0)
+    {
+#if defined(__SANITIZE_ADDRESS__) || !defined(__OPTIMIZE__)
+        // The baseline is recorded with the optimized build; timings of this
+        // one would mostly measure the sanitizers.
+        cerr << "--perf-reps needs the optimized test driver: make perftest, then ./perftest --perf-reps N" << endl;
+        return 1;
+#endif
+        if (jobs != 1)
+        {
+            cerr << "--perf-reps times one test at a time, run it without -j N" << endl;
+            return 1;
+        }
+    }
+    svg::TestDriver driver(args.size() == 2 ? args[1] : ".", jobs);
+    if (perf.reps > 0)
+    {
+        driver.set_perf_options(perf);
+    }
+    driver.set_render_options(render);
+    string spec = args.size() >= 1 ? args[0] : "";
     driver.run_tests(spec);
 
     return 0;
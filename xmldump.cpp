@@ -2,7 +2,18 @@
 
 using namespace tinyxml2;
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 void dump(XMLElement *elem, int indentation)
 {
@@ -21,12 +32,516 @@ void dump(XMLElement *elem, int indentation)
     }
 }
 
+// Statistics of an SVG file gathered while scanning it, without building a
+// DOM: tags are read one character at a time from a small buffer, and the
+// values of points attributes are consumed as they are read.
+class SVGStats
+{
+public:
+    // Scan a file; returns false if it cannot be opened.
+    bool scan(const char *file_name)
+    {
+        file = std::fopen(file_name, "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+        int c;
+        while ((c = get()) != EOF)
+        {
+            if (c != '<')
+            {
+                continue;
+            }
+            c = get();
+            if (c == '!')
+            {
+                skip_declaration();
+            }
+            else if (c == '?')
+            {
+                skip_until("?>");
+            }
+            else if (c == '/')
+            {
+                skip_until(">");
+                close_element();
+            }
+            else if (c != EOF)
+            {
+                read_tag(c);
+            }
+        }
+        std::fclose(file);
+        return true;
+    }
+
+    void print() const
+    {
+        std::cout << "bytes: " << bytes << std::endl
+                  << "elements: " << elements << std::endl
+                  << "max group depth: " << max_group_depth << std::endl
+                  << "points: " << total_points << " total, " << max_points << " max per element" << std::endl
+                  << "use references: " << uses << std::endl
+                  << "transforms: " << transforms << std::endl
+                  << std::left << std::setw(12) << "tag" << std::right << std::setw(10) << "count"
+                  << std::setw(12) << "points" << std::setw(16) << "est. cost" << std::endl;
+        std::vector<std::pair<std::string, TagStats>> rows(tags.begin(), tags.end());
+        std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, TagStats> &a, const std::pair<std::string, TagStats> &b)
+                  { return a.second.cost > b.second.cost; });
+        for (const auto &row : rows)
+        {
+            std::cout << std::left << std::setw(12) << row.first << std::right << std::setw(10) << row.second.count
+                      << std::setw(12) << row.second.points << std::setw(16) << (long long)row.second.cost << std::endl;
+        }
+        std::cout << "Estimated cost: about the pixels and edge crossings a shape costs to"
+                  << " draw, ignoring transforms; uses count their referenced element." << std::endl;
+    }
+
+private:
+    struct TagStats
+    {
+        long long count = 0;
+        long long points = 0;
+        double cost = 0;
+    };
+
+    // An element that has been opened and not yet closed.
+    struct Open
+    {
+        std::string name;
+        std::string id;
+        // Cost of the element and of its children.
+        double cost;
+    };
+
+    // Attributes of the element being read; points are summarized.
+    struct Attributes
+    {
+        std::map<std::string, std::string> values;
+        long long points = 0;
+        double x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        double length = 0;
+        double last_x = 0, last_y = 0;
+    };
+
+    // Attribute values longer than this are not kept (only points matter).
+    static const size_t MAX_VALUE = 256;
+
+    FILE *file = nullptr;
+    char buffer[65536];
+    size_t buffer_pos = 0, buffer_len = 0;
+
+    long long bytes = 0, elements = 0, total_points = 0, max_points = 0, uses = 0, transforms = 0;
+    int group_depth = 0, max_group_depth = 0;
+    std::map<std::string, TagStats> tags;
+    std::vector<Open> open;
+    std::unordered_map<std::string, double> cost_by_id;
+
+    int get()
+    {
+        if (buffer_pos == buffer_len)
+        {
+            buffer_len = std::fread(buffer, 1, sizeof(buffer), file);
+            buffer_pos = 0;
+            bytes += buffer_len;
+            if (buffer_len == 0)
+            {
+                return EOF;
+            }
+        }
+        return (unsigned char)buffer[buffer_pos++];
+    }
+
+    // Skip past the given terminator (or to the end of the file). The last
+    // characters read are compared with it, so overlapping partial matches
+    // such as "]]]>" for "]]>" are found.
+    void skip_until(const char *end)
+    {
+        size_t n = std::strlen(end);
+        std::string last;
+        int c;
+        while ((c = get()) != EOF)
+        {
+            last += (char)c;
+            if (last.size() > n)
+            {
+                last.erase(0, 1);
+            }
+            if (last == end)
+            {
+                return;
+            }
+        }
+    }
+
+    // Comments, CDATA sections and other <!...> declarations.
+    void skip_declaration()
+    {
+        int c = get();
+        if (c == '-')
+        {
+            get();
+            skip_until("-->");
+        }
+        else if (c == '[')
+        {
+            skip_until("]]>");
+        }
+        else if (c != '>')
+        {
+            skip_until(">");
+        }
+    }
+
+    static bool is_space(int c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    // Read a start tag (its first name character already read).
+    void read_tag(int c)
+    {
+        std::string name;
+        while (c != EOF && !is_space(c) && c != '>' && c != '/')
+        {
+            name += (char)c;
+            c = get();
+        }
+        Attributes attributes;
+        bool self_closing = false;
+        while (c != EOF && c != '>')
+        {
+            if (c == '/')
+            {
+                self_closing = true;
+            }
+            else if (!is_space(c))
+            {
+                read_attribute(c, attributes);
+            }
+            c = get();
+        }
+        open_element(name, attributes);
+        if (self_closing)
+        {
+            close_element();
+        }
+    }
+
+    // Read name="value" (the first name character already read).
+    void read_attribute(int c, Attributes &attributes)
+    {
+        std::string name;
+        while (c != EOF && c != '=' && !is_space(c))
+        {
+            name += (char)c;
+            c = get();
+        }
+        while (c != EOF && c != '"' && c != '\'')
+        {
+            c = get();
+        }
+        int quote = c;
+        if (name == "points")
+        {
+            read_points(quote, attributes);
+            return;
+        }
+        if (name == "d")
+        {
+            read_path_data(quote, attributes);
+            return;
+        }
+        std::string value;
+        while ((c = get()) != EOF && c != quote)
+        {
+            if (value.size() < MAX_VALUE)
+            {
+                value += (char)c;
+            }
+        }
+        attributes.values[name] = value;
+    }
+
+    // Read the numbers of an attribute value up to the closing quote,
+    // passing each one to on_number and any other character that is not a
+    // separator to on_other.
+    template <typename Number, typename Other>
+    void read_numbers(int quote, Number on_number, Other on_other)
+    {
+        char number[64];
+        size_t len = 0;
+        int c;
+        do
+        {
+            c = get();
+            bool numeric = (c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' ||
+                           ((c == '-' || c == '+') && (len == 0 || number[len - 1] == 'e' || number[len - 1] == 'E'));
+            if (numeric && len + 1 < sizeof(number))
+            {
+                number[len++] = (char)c;
+                continue;
+            }
+            if (len > 0)
+            {
+                number[len] = '\0';
+                on_number(std::atof(number));
+                len = 0;
+            }
+            // A sign also starts the next number.
+            if (c == '-' || c == '+')
+            {
+                number[len++] = (char)c;
+            }
+            else if (c != EOF && c != quote && c != ',' && !is_space(c))
+            {
+                on_other(c);
+            }
+        } while (c != EOF && c != quote);
+    }
+
+    // Count the points of a points attribute, with their bounding box and path length.
+    void read_points(int quote, Attributes &a)
+    {
+        double coordinate[2];
+        int n = 0;
+        read_numbers(quote, [&](double v)
+                     {
+                         coordinate[n++] = v;
+                         if (n == 2)
+                         {
+                             add_point(a, coordinate[0], coordinate[1]);
+                             n = 0;
+                         }
+                     },
+                     [](int) {});
+    }
+
+    // Number of arguments of a path command (M/L/H/V/C/S/Q/T/Z, any case).
+    static int path_arguments(int command)
+    {
+        switch (std::toupper(command))
+        {
+        case 'H':
+        case 'V':
+            return 1;
+        case 'M':
+        case 'L':
+        case 'T':
+            return 2;
+        case 'S':
+        case 'Q':
+            return 4;
+        case 'C':
+            return 6;
+        default:
+            return 0;
+        }
+    }
+
+    // Count the end points of the commands of a d attribute, with the
+    // bounding box of all their coordinates (control points included, which
+    // bound the curves).
+    void read_path_data(int quote, Attributes &a)
+    {
+        int command = 0;
+        double args[6];
+        int n = 0;
+        double x = 0, y = 0, start_x = 0, start_y = 0;
+        read_numbers(quote, [&](double v)
+                     {
+                         if (path_arguments(command) == 0)
+                         {
+                             return;
+                         }
+                         args[n++] = v;
+                         if (n < path_arguments(command))
+                         {
+                             return;
+                         }
+                         n = 0;
+                         bool relative = std::islower(command);
+                         double ox = relative ? x : 0, oy = relative ? y : 0;
+                         int upper = std::toupper(command);
+                         if (upper == 'H')
+                         {
+                             x = ox + args[0];
+                         }
+                         else if (upper == 'V')
+                         {
+                             y = oy + args[0];
+                         }
+                         else
+                         {
+                             // Control points, then the end point.
+                             int last = path_arguments(command) - 2;
+                             for (int i = 0; i < last && a.points > 0; i += 2)
+                             {
+                                 extend_box(a, ox + args[i], oy + args[i + 1]);
+                             }
+                             x = ox + args[last];
+                             y = oy + args[last + 1];
+                         }
+                         add_point(a, x, y);
+                         if (upper == 'M')
+                         {
+                             start_x = x;
+                             start_y = y;
+                             // Further coordinate pairs are lines.
+                             command = relative ? 'l' : 'L';
+                         }
+                     },
+                     [&](int c)
+                     {
+                         command = c;
+                         n = 0;
+                         if (c == 'Z' || c == 'z')
+                         {
+                             x = start_x;
+                             y = start_y;
+                         }
+                     });
+    }
+
+    static void extend_box(Attributes &a, double x, double y)
+    {
+        a.x0 = std::min(a.x0, x);
+        a.x1 = std::max(a.x1, x);
+        a.y0 = std::min(a.y0, y);
+        a.y1 = std::max(a.y1, y);
+    }
+
+    static void add_point(Attributes &a, double x, double y)
+    {
+        if (a.points == 0)
+        {
+            a.x0 = a.x1 = x;
+            a.y0 = a.y1 = y;
+        }
+        else
+        {
+            extend_box(a, x, y);
+            a.length += std::hypot(x - a.last_x, y - a.last_y);
+        }
+        a.last_x = x;
+        a.last_y = y;
+        a.points++;
+    }
+
+    static double number(const Attributes &a, const char *name, double fallback = 0)
+    {
+        auto it = a.values.find(name);
+        return it == a.values.end() ? fallback : std::atof(it->second.c_str());
+    }
+
+    // Estimated drawing cost: filled pixels, plus one per edge crossing on
+    // every row for polygons and paths (whose curves count as one edge), or
+    // the stroked length for lines.
+    static double estimate_cost(const std::string &name, const Attributes &a)
+    {
+        double stroke = std::max(1.0, number(a, "stroke-width", 1.0));
+        if (name == "rect")
+        {
+            return std::fabs(number(a, "width") * number(a, "height"));
+        }
+        if (name == "circle")
+        {
+            double r = number(a, "r");
+            return M_PI * r * r;
+        }
+        if (name == "ellipse")
+        {
+            return std::fabs(M_PI * number(a, "rx") * number(a, "ry"));
+        }
+        if (name == "line")
+        {
+            return stroke * std::hypot(number(a, "x2") - number(a, "x1"), number(a, "y2") - number(a, "y1"));
+        }
+        if (name == "polyline")
+        {
+            return stroke * a.length + a.points;
+        }
+        if (name == "polygon" || name == "path")
+        {
+            double height = a.y1 - a.y0 + 1;
+            return (a.x1 - a.x0 + 1) * height + a.points * height;
+        }
+        return 0;
+    }
+
+    void open_element(const std::string &name, const Attributes &a)
+    {
+        elements++;
+        TagStats &tag = tags[name];
+        tag.count++;
+        tag.points += a.points;
+        total_points += a.points;
+        max_points = std::max(max_points, a.points);
+        if (a.values.count("transform"))
+        {
+            transforms++;
+        }
+        double cost = estimate_cost(name, a);
+        if (name == "use")
+        {
+            uses++;
+            auto href = a.values.find("href");
+            if (href != a.values.end() && !href->second.empty())
+            {
+                auto it = cost_by_id.find(href->second.substr(1));
+                cost = it == cost_by_id.end() ? 0 : it->second;
+            }
+        }
+        tag.cost += cost;
+        if (name == "g")
+        {
+            max_group_depth = std::max(max_group_depth, ++group_depth);
+        }
+        auto id = a.values.find("id");
+        open.push_back({name, id == a.values.end() ? std::string() : id->second, cost});
+    }
+
+    void close_element()
+    {
+        if (open.empty())
+        {
+            return;
+        }
+        Open e = open.back();
+        open.pop_back();
+        if (e.name == "g")
+        {
+            group_depth--;
+        }
+        if (!e.id.empty())
+        {
+            cost_by_id[e.id] = e.cost;
+        }
+        if (!open.empty())
+        {
+            open.back().cost += e.cost;
+        }
+    }
+};
+
 int main(int argc, char **argv)
 {
     XMLDocument doc;
-    if (argc != 2)
+    if (argc == 3 && std::string(argv[1]) == "--stats")
+    {
+        SVGStats stats;
+        if (!stats.scan(argv[2]))
+        {
+            std::cout << "Unable to open " << argv[2] << std::endl;
+            return 1;
+        }
+        stats.print();
+    }
+    else if (argc != 2)
     {
-        std::cout << "Usage: xmldump filename";
+        std::cout << "Usage: xmldump filename" << std::endl
+                  << "       xmldump --stats filename" << std::endl;
     }
     else
     {
@@ -34,4 +549,4 @@ int main(int argc, char **argv)
         dump(doc.RootElement(), 0);
     }
     return 0;
-}
\ No newline at end of file
+}